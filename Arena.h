@@ -0,0 +1,57 @@
+// Single allocation holding the complex sample blocks of a processor.
+
+#ifndef PATHSIM_ARENA_HPP
+#define PATHSIM_ARENA_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "cmplx.h"
+
+namespace PathSim {
+
+// Blocks of complex samples in the structure of arrays layout, all planes carved out of one
+// contiguous buffer. Each plane starts at a cache line boundary, so the SIMD kernels never
+// split a vector load between two cache lines of a plane and the planes do not share lines.
+template<typename T>
+class Arena
+{
+public:
+	static constexpr size_t ALIGNMENT = 64;
+
+	// Allocate num_blocks zeroed complex blocks of len samples each.
+	// Blocks returned before a call to init() are invalidated.
+	void init(int num_blocks, int len) { this->init(std::vector<int>(num_blocks, len)); }
+	// Allocate zeroed complex blocks of lengths lens[0], lens[1] ...
+	void init(const std::vector<int> &lens)
+	{
+		m_offsets.assign(lens.size() + 1, 0);
+		for (size_t j = 0; j < lens.size(); ++ j)
+			m_offsets[j + 1] = m_offsets[j] + 2 * round_up(size_t(lens[j]));
+		m_storage.assign(m_offsets.back() + ALIGNMENT / sizeof(T), T(0));
+		uintptr_t addr = reinterpret_cast<uintptr_t>(m_storage.data());
+		m_base = m_storage.data() + ((ALIGNMENT - addr % ALIGNMENT) % ALIGNMENT) / sizeof(T);
+	}
+
+	int 			num_blocks() const { return int(m_offsets.size()) - 1; }
+	cmplx_block<T> 	block(int idx)
+	{
+		// The imaginary plane follows the real one.
+		T *r = m_base + m_offsets[idx];
+		return { r, r + (m_offsets[idx + 1] - m_offsets[idx]) / 2 };
+	}
+	cmplx_block<const T> block(int idx) const { return const_cast<Arena*>(this)->block(idx); }
+
+private:
+	static size_t 	round_up(size_t len) { const size_t align = ALIGNMENT / sizeof(T); return (len + align - 1) / align * align; }
+
+	std::vector<T> 	m_storage;
+	T 			   *m_base 		{ nullptr };
+	// Start of each block relative to m_base, the last item is the total size.
+	std::vector<size_t> m_offsets;
+};
+
+} // namespace PathSim
+
+#endif // PATHSIM_ARENA_HPP
@@ -396,7 +396,7 @@ void AudioFile<T>::shouldLogErrorsToConsole (bool logErrors)
 template <class T>
 bool AudioFile<T>::load (std::string filePath)
 {
-    std::ifstream file (filePath, std::ios::binary);
+    std::ifstream file (filePath, std::ios::binary | std::ios::ate);
     
     // check the file exists
     if (! file.good())
@@ -405,9 +405,23 @@ bool AudioFile<T>::load (std::string filePath)
         return false;
     }
     
-    file.unsetf (std::ios::skipws);
-    std::istream_iterator<uint8_t> begin (file), end;
-    std::vector<uint8_t> fileData (begin, end);
+    // size the buffer by the length of the file and read it in a single call
+    std::streamoff fileSize = file.tellg();
+    file.seekg (0, std::ios::beg);
+    std::vector<uint8_t> fileData (fileSize > 0 ? (size_t) fileSize : 0);
+    
+    if (fileSize > 0 && ! file.read (reinterpret_cast<char*> (fileData.data()), (std::streamsize) fileSize))
+    {
+        reportError ("ERROR: couldn't read file\n" + filePath);
+        return false;
+    }
+    
+    // the shortest header checked is the 12 bytes of the RIFF or FORM chunk
+    if (fileData.size() < 12)
+    {
+        reportError ("Audio File Type: Error");
+        return false;
+    }
     
     // get audio file format
     audioFileFormat = determineAudioFileFormat (fileData);
@@ -501,42 +515,46 @@ bool AudioFile<T>::decodeWaveFile (std::vector<uint8_t>& fileData)
     int numSamples = dataChunkSize / (numChannels * bitDepth / 8);
     int samplesStartIndex = indexOfDataChunk + 8;
     
+    // don't read past the end of a truncated file
+    int numSamplesInFile = (int) ((fileData.size() - std::min (fileData.size(), (size_t) samplesStartIndex)) / numBytesPerBlock);
+    numSamples = std::max (0, std::min (numSamples, numSamplesInFile));
+    
     clearAudioBuffer();
     samples.resize (numChannels);
     
-    for (int i = 0; i < numSamples; i++)
+    // each channel is sized up front, then converted by a loop over its samples
+    for (int channel = 0; channel < numChannels; channel++)
     {
-        for (int channel = 0; channel < numChannels; channel++)
+        samples[channel].resize (numSamples);
+        T* out = samples[channel].data();
+        const uint8_t* in = fileData.data() + samplesStartIndex + channel * numBytesPerSample;
+        
+        if (bitDepth == 8)
         {
-            int sampleIndex = samplesStartIndex + (numBytesPerBlock * i) + channel * numBytesPerSample;
-            
-            if (bitDepth == 8)
-            {
-                T sample = singleByteToSample (fileData[sampleIndex]);
-                samples[channel].push_back (sample);
-            }
-            else if (bitDepth == 16)
-            {
-                int16_t sampleAsInt = twoBytesToInt (fileData, sampleIndex);
-                T sample = sixteenBitIntToSample (sampleAsInt);
-                samples[channel].push_back (sample);
-            }
-            else if (bitDepth == 24)
+            for (int i = 0; i < numSamples; i++, in += numBytesPerBlock)
+                out[i] = singleByteToSample (in[0]);
+        }
+        else if (bitDepth == 16)
+        {
+            for (int i = 0; i < numSamples; i++, in += numBytesPerBlock)
+                out[i] = sixteenBitIntToSample ((int16_t) ((in[1] << 8) | in[0]));
+        }
+        else if (bitDepth == 24)
+        {
+            for (int i = 0; i < numSamples; i++, in += numBytesPerBlock)
             {
-                int32_t sampleAsInt = 0;
-                sampleAsInt = (fileData[sampleIndex + 2] << 16) | (fileData[sampleIndex + 1] << 8) | fileData[sampleIndex];
+                int32_t sampleAsInt = (in[2] << 16) | (in[1] << 8) | in[0];
                 
                 if (sampleAsInt & 0x800000) //  if the 24th bit is set, this is a negative number in 24-bit world
                     sampleAsInt = sampleAsInt | ~0xFFFFFF; // so make sure sign is extended to the 32 bit float
-
-                T sample = (T)sampleAsInt / (T)8388608.;
-                samples[channel].push_back (sample);
-            }
-            else
-            {
-                assert (false);
+                
+                out[i] = (T)sampleAsInt / (T)8388608.;
             }
         }
+        else
+        {
+            assert (false);
+        }
     }
 
     return true;
@@ -619,40 +637,39 @@ bool AudioFile<T>::decodeAiffFile (std::vector<uint8_t>& fileData)
     clearAudioBuffer();
     samples.resize (numChannels);
     
-    for (int i = 0; i < numSamplesPerChannel; i++)
+    // each channel is sized up front, then converted by a loop over its samples
+    for (int channel = 0; channel < numChannels; channel++)
     {
-        for (int channel = 0; channel < numChannels; channel++)
+        samples[channel].resize (numSamplesPerChannel);
+        T* out = samples[channel].data();
+        const uint8_t* in = fileData.data() + samplesStartIndex + channel * numBytesPerSample;
+        
+        if (bitDepth == 8)
         {
-            int sampleIndex = samplesStartIndex + (numBytesPerFrame * i) + channel * numBytesPerSample;
-            
-            if (bitDepth == 8)
-            {
-                int8_t sampleAsSigned8Bit = (int8_t)fileData[sampleIndex];
-                T sample = (T)sampleAsSigned8Bit / (T)128.;
-                samples[channel].push_back (sample);
-            }
-            else if (bitDepth == 16)
-            {
-                int16_t sampleAsInt = twoBytesToInt (fileData, sampleIndex, Endianness::BigEndian);
-                T sample = sixteenBitIntToSample (sampleAsInt);
-                samples[channel].push_back (sample);
-            }
-            else if (bitDepth == 24)
+            for (int i = 0; i < numSamplesPerChannel; i++, in += numBytesPerFrame)
+                out[i] = (T)(int8_t)in[0] / (T)128.;
+        }
+        else if (bitDepth == 16)
+        {
+            for (int i = 0; i < numSamplesPerChannel; i++, in += numBytesPerFrame)
+                out[i] = sixteenBitIntToSample ((int16_t) ((in[0] << 8) | in[1]));
+        }
+        else if (bitDepth == 24)
+        {
+            for (int i = 0; i < numSamplesPerChannel; i++, in += numBytesPerFrame)
             {
-                int32_t sampleAsInt = 0;
-                sampleAsInt = (fileData[sampleIndex] << 16) | (fileData[sampleIndex + 1] << 8) | fileData[sampleIndex + 2];
+                int32_t sampleAsInt = (in[0] << 16) | (in[1] << 8) | in[2];
                 
                 if (sampleAsInt & 0x800000) //  if the 24th bit is set, this is a negative number in 24-bit world
                     sampleAsInt = sampleAsInt | ~0xFFFFFF; // so make sure sign is extended to the 32 bit float
                 
-                T sample = (T)sampleAsInt / (T)8388608.;
-                samples[channel].push_back (sample);
-            }
-            else
-            {
-                assert (false);
+                out[i] = (T)sampleAsInt / (T)8388608.;
             }
         }
+        else
+        {
+            assert (false);
+        }
     }
     
     return true;
@@ -1015,21 +1032,10 @@ int16_t AudioFile<T>::twoBytesToInt (std::vector<uint8_t>& source, int startInde
 template <class T>
 int AudioFile<T>::getIndexOfString (std::vector<uint8_t>& source, std::string stringToSearchFor)
 {
-    int index = -1;
-    int stringLength = (int)stringToSearchFor.length();
-    
-    for (size_t i = 0; i < source.size() - stringLength;i++)
-    {
-        std::string section (source.begin() + i, source.begin() + i + stringLength);
-        
-        if (section == stringToSearchFor)
-        {
-            index = static_cast<int> (i);
-            break;
-        }
-    }
+    // compare the bytes in place rather than building a string at each position
+    auto it = std::search (source.begin(), source.end(), stringToSearchFor.begin(), stringToSearchFor.end());
     
-    return index;
+    return it == source.end() ? -1 : static_cast<int> (it - source.begin());
 }
 
 //=============================================================
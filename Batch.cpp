@@ -0,0 +1,161 @@
+// Batch processing of the audio files listed in a manifest.
+
+#include "Batch.h"
+#include "PathSimProcessor.h"
+#include "WorkerPool.h"
+#include "AudioFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace PathSim {
+
+bool read_manifest(const std::string &path, std::vector<BatchEntry> &entries, std::string &error)
+{
+	std::ifstream file(path);
+	if (! file) {
+		error = "failed opening manifest " + path;
+		return false;
+	}
+	std::string line;
+	for (int num = 1; std::getline(file, line); ++ num) {
+		std::istringstream fields(line);
+		BatchEntry entry;
+		entry.line = num;
+		if (! (fields >> entry.input_file) || entry.input_file.front() == '#')
+			continue;
+		std::string seed;
+		if (! (fields >> entry.output_file)) {
+			error = path + ":" + std::to_string(num) + ": output file missing";
+			return false;
+		}
+		if ((fields >> entry.profile) && entry.profile == "-")
+			entry.profile.clear();
+		if (fields >> seed) {
+			size_t end = 0;
+			try {
+				entry.seed = std::stoull(seed, &end);
+			} catch (const std::exception &) {
+			}
+			if (end == 0 || end != seed.size()) {
+				error = path + ":" + std::to_string(num) + ": invalid seed " + seed;
+				return false;
+			}
+			entry.has_seed = true;
+		}
+		std::string extra;
+		if (fields >> extra) {
+			error = path + ":" + std::to_string(num) + ": unexpected " + extra;
+			return false;
+		}
+		entries.emplace_back(std::move(entry));
+	}
+	return true;
+}
+
+struct JobResult
+{
+	bool        ok          { false };
+	std::string error;
+	size_t      samples     { 0 };
+	double      sample_rate { 0. };
+	// Time of the whole job and of the processing alone, seconds.
+	double      total       { 0. };
+	double      process     { 0. };
+};
+
+// State of a thread of the pool, see run_job_queue().
+template<typename T>
+struct BatchWorker
+{
+	BatchWorker() { audio_file.shouldLogErrorsToConsole(false); }
+
+	PathSimProcessor<T> processor;
+	AudioFile<T>        audio_file;
+};
+
+template<typename T>
+static void run_job(const BatchJob &job, const OutputFormat &format, BatchWorker<T> &worker, JobResult &result)
+{
+	auto t0 = std::chrono::steady_clock::now();
+	AudioFile<T> &audio_file = worker.audio_file;
+	if (! audio_file.load(job.input_file)) {
+		result.error = "failed loading input file";
+		return;
+	}
+	result.sample_rate = audio_file.getSampleRate();
+	if (result.sample_rate < PathSimProcessor<T>::MIN_SAMPLE_RATE || result.sample_rate > PathSimProcessor<T>::MAX_SAMPLE_RATE) {
+		result.error = "unsupported sample rate " + std::to_string(audio_file.getSampleRate()) + " Hz";
+		return;
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	PathSimProcessor<T> &processor = worker.processor;
+	processor.init(job.params, result.sample_rate);
+	std::vector<T> &samples = audio_file.samples.front();
+	const int    bufsize = processor.block_size();
+	const size_t len     = samples.size();
+	const size_t nblocks = (len + bufsize - 1) / bufsize;
+	samples.resize(nblocks * bufsize, T(0));
+	for (size_t i = 0; i < nblocks; ++ i)
+		processor.process_buffer(samples.data() + i * bufsize);
+	result.process = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+	OutputFormat job_format = format;
+	job_format.dither_seed = job.params.seed;
+	if (! write_wav_file(job.output_file, samples.data(), len, audio_file.getSampleRate(), audio_file.getNumChannels(),
+			pcm_format(audio_file.getBitDepth()), job_format)) {
+		result.error = "failed saving output file";
+		return;
+	}
+	result.samples = len;
+	result.total   = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	result.ok      = true;
+}
+
+template<typename T>
+static void run_jobs(const std::vector<BatchJob> &jobs, int threads, const OutputFormat &format, std::vector<JobResult> &results)
+{
+	run_job_queue<BatchWorker<T>>(jobs.size(), threads, [&](size_t i, BatchWorker<T> &worker) {
+		run_job(jobs[i], format, worker, results[i]);
+	});
+}
+
+int run_batch(const std::vector<BatchJob> &jobs, int threads, bool single_precision, const OutputFormat &format, std::ostream &out)
+{
+	threads = std::max(1, std::min(threads, int(jobs.size())));
+	std::vector<JobResult> results(jobs.size());
+	auto t0 = std::chrono::steady_clock::now();
+	if (single_precision)
+		run_jobs<float>(jobs, threads, format, results);
+	else
+		run_jobs<double>(jobs, threads, format, results);
+	double wall = std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+
+	int    failed   = 0;
+	size_t samples  = 0;
+	double duration = 0.;
+	for (size_t i = 0; i < jobs.size(); ++ i) {
+		const JobResult &r = results[i];
+		out << std::fixed << "[" << i + 1 << "] " << jobs[i].input_file;
+		if (! r.ok) {
+			out << ": " << r.error << std::endl;
+			++ failed;
+			continue;
+		}
+		out << " -> " << jobs[i].output_file << ": " << r.samples << " samples at " << std::setprecision(0) << r.sample_rate
+			<< " Hz, " << std::setprecision(3) << r.total * 1000. << " ms (processing " << r.process * 1000. << " ms), "
+			<< std::setprecision(2) << double(r.samples) / std::max(r.total, 1e-9) * 1e-6 << " MSamples/s" << std::endl;
+		samples  += r.samples;
+		duration += double(r.samples) / r.sample_rate;
+	}
+	out << std::fixed << "batch: " << jobs.size() << " jobs, " << failed << " failed, " << threads << " threads, "
+		<< samples << " samples in " << std::setprecision(3) << wall << " s: "
+		<< std::setprecision(2) << double(samples) / wall * 1e-6 << " MSamples/s, "
+		<< std::setprecision(1) << double(jobs.size()) / wall << " jobs/s, "
+		<< duration / wall << "x realtime" << std::endl;
+	return failed;
+}
+
+} // namespace PathSim
@@ -0,0 +1,49 @@
+// Batch processing of the audio files listed in a manifest.
+
+#ifndef PATHSIM_BATCH_HPP
+#define PATHSIM_BATCH_HPP
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "PathSimParams.h"
+#include "WavStream.h"
+
+namespace PathSim {
+
+// A line of the manifest.
+struct BatchEntry
+{
+	std::string     input_file;
+	std::string     output_file;
+	// Propagation condition as named on the command line without the dashes, empty if not given or "-".
+	std::string     profile;
+	bool            has_seed    { false };
+	uint64_t        seed        { 0 };
+	// Line number in the manifest, for the messages.
+	int             line        { 0 };
+};
+
+// Read the manifest: a job per line "input output [profile [seed]]" separated by white space.
+// Empty lines and lines starting with '#' are skipped. Returns false with a message on a malformed line.
+extern bool read_manifest(const std::string &path, std::vector<BatchEntry> &entries, std::string &error);
+
+struct BatchJob
+{
+	std::string     input_file;
+	std::string     output_file;
+	PathSimParams   params;
+};
+
+// Process the jobs on a pool of threads. Each thread keeps its processor and its audio buffers and reuses
+// them for all the jobs it takes, the jobs are taken in the order of the manifest from a shared counter.
+// Each job is processed in blocks, see PathSimProcessor::process_buffer(), by the double or by the single
+// precision chain, and written in the format, dithered by the seed of the job. Reports each job in the manifest
+// order and the aggregate throughput to out. Returns the number of the failed jobs.
+extern int run_batch(const std::vector<BatchJob> &jobs, int threads, bool single_precision, const OutputFormat &format, std::ostream &out);
+
+} // namespace PathSim
+
+#endif // PATHSIM_BATCH_HPP
@@ -0,0 +1,232 @@
+// Throughput and accuracy benchmark of the simulator.
+
+#include "Benchmark.h"
+#include "PathSimProcessor.h"
+#include "Pipeline.h"
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+namespace PathSim {
+
+// Number of timed runs of each variant, the fastest one is reported.
+static constexpr int BENCHMARK_RUNS = 3;
+// Samples per call of the streaming interface, a typical audio callback.
+static constexpr int STREAM_FRAMES = 128;
+
+// Process the input padded to whole blocks, return the best time of BENCHMARK_RUNS in seconds.
+template<typename T>
+static double benchmark_chain(const PathSimParams &params, const std::vector<double> &input, double sample_rate, std::vector<double> &output)
+{
+    std::vector<T> buffer;
+    double best = 0.;
+    for (int run = 0; run < BENCHMARK_RUNS; ++ run) {
+        PathSimProcessor<T> processor;
+        processor.init(params, sample_rate);
+        const int bufsize = processor.block_size();
+        const int nblocks = int((input.size() + bufsize - 1) / bufsize);
+        buffer.assign(size_t(nblocks) * bufsize, T(0));
+        std::copy(input.begin(), input.end(), buffer.begin());
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < nblocks; ++ i)
+            processor.process_buffer(buffer.data() + size_t(i) * bufsize);
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (run == 0 || t < best)
+            best = t;
+    }
+    output.assign(buffer.begin(), buffer.begin() + input.size());
+    return best;
+}
+
+// Stream the input through the process() method of PathSimProcessor or ResamplingProcessor in calls
+// of STREAM_FRAMES samples. Return the best total time of BENCHMARK_RUNS in seconds and the longest call of that run.
+template<typename T, template<typename> class Processor = PathSimProcessor>
+static double benchmark_stream(const PathSimParams &params, const std::vector<double> &input, double sample_rate, double &longest_call)
+{
+    std::vector<T> in(input.begin(), input.end());
+    std::vector<T> out(input.size(), T(0));
+    double best = 0.;
+    for (int run = 0; run < BENCHMARK_RUNS; ++ run) {
+        Processor<T> processor;
+        processor.init(params, sample_rate);
+        double longest = 0.;
+        auto t0 = std::chrono::steady_clock::now();
+        auto t  = t0;
+        for (size_t i = 0; i < in.size(); i += STREAM_FRAMES) {
+            processor.process(in.data() + i, out.data() + i, std::min<size_t>(STREAM_FRAMES, in.size() - i));
+            auto t1 = std::chrono::steady_clock::now();
+            longest = std::max(longest, std::chrono::duration<double>(t1 - t).count());
+            t = t1;
+        }
+        double total = std::chrono::duration<double>(t - t0).count();
+        if (run == 0 || total < best) {
+            best = total;
+            longest_call = longest;
+        }
+    }
+    return best;
+}
+
+// Convert the input down and back up by the resamplers of the processor alone, in calls of STREAM_FRAMES samples.
+// Return the best time of BENCHMARK_RUNS in seconds.
+template<typename T>
+static double benchmark_resamplers(const ResamplingProcessor<T> &processor, const std::vector<double> &input)
+{
+    std::vector<T> in(input.begin(), input.end());
+    std::vector<T> low(processor.down_converter().max_output(STREAM_FRAMES), T(0));
+    std::vector<T> out(processor.up_converter().max_output(int(low.size())), T(0));
+    double best = 0.;
+    for (int run = 0; run < BENCHMARK_RUNS; ++ run) {
+        Resampler<T> down = processor.down_converter();
+        Resampler<T> up   = processor.up_converter();
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < in.size(); i += STREAM_FRAMES) {
+            int n = down.process(in.data() + i, int(std::min<size_t>(STREAM_FRAMES, in.size() - i)), low.data());
+            up.process(low.data(), n, out.data());
+        }
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (run == 0 || t < best)
+            best = t;
+    }
+    return best;
+}
+
+// Measure the latency of the streaming interface: an impulse is streamed through a single path
+// without fading, Doppler, delay and noise, the output peaks at the latency.
+template<typename T, template<typename> class Processor = PathSimProcessor>
+static int measure_latency(const PathSimParams &params, double sample_rate)
+{
+    PathSimParams impulse_params = params;
+    if (! impulse_params.paths.empty())
+        impulse_params.paths.assign(1, PathParams());
+    impulse_params.noise.has_awgn = false;
+    Processor<T> processor;
+    processor.init(impulse_params, sample_rate);
+    std::vector<T> signal(2 * size_t(processor.latency() + STREAM_FRAMES), T(0));
+    signal.front() = T(1);
+    for (size_t i = 0; i < signal.size(); i += STREAM_FRAMES)
+        processor.process(signal.data() + i, signal.data() + i, std::min<size_t>(STREAM_FRAMES, signal.size() - i));
+    size_t peak = 0;
+    for (size_t i = 1; i < signal.size(); ++ i)
+        if (fabs(signal[i]) > fabs(signal[peak]))
+            peak = i;
+    return int(peak);
+}
+
+static void report_throughput(std::ostream &out, const char *name, double seconds, size_t samples, double sample_rate)
+{
+    out << "  " << std::left << std::setw(10) << name << std::right << std::fixed
+        << std::setw(10) << std::setprecision(3) << seconds * 1000. << " ms"
+        << std::setw(12) << std::setprecision(2) << double(samples) / seconds * 1e-6 << " MSamples/s"
+        << std::setw(10) << std::setprecision(1) << double(samples) / sample_rate / seconds << "x realtime" << std::endl;
+}
+
+void run_benchmark(const PathSimParams &params, const std::vector<double> &input, double sample_rate, std::ostream &out)
+{
+    std::vector<double> out_double, out_float;
+    double t_double = benchmark_chain<double>(params, input, sample_rate, out_double);
+    double t_float  = benchmark_chain<float> (params, input, sample_rate, out_float);
+
+    out << "pathsim benchmark: " << (params.title.empty() ? std::string("custom") : params.title)
+        << ", " << input.size() << " samples, best of " << BENCHMARK_RUNS << " runs";
+    if (params.threads > 1)
+        out << ", " << params.threads << " threads";
+    out << std::endl;
+    report_throughput(out, "double", t_double, input.size(), sample_rate);
+    report_throughput(out, "float", t_float, input.size(), sample_rate);
+    out << "  float speedup " << std::setprecision(2) << t_double / t_float << "x" << std::endl;
+
+    // Difference of the single precision output relative to the double precision output.
+    double max_diff = 0.;
+    double sum_diff = 0.;
+    double sum_sig  = 0.;
+    for (size_t i = 0; i < input.size(); ++ i) {
+        double d = out_float[i] - out_double[i];
+        max_diff  = std::max(max_diff, fabs(d));
+        sum_diff += d * d;
+        sum_sig  += out_double[i] * out_double[i];
+    }
+    double rms_diff = sqrt(sum_diff / std::max<size_t>(1, input.size()));
+    double rms_sig  = sqrt(sum_sig  / std::max<size_t>(1, input.size()));
+    if (max_diff == 0.)
+        out << "  float - double: identical" << std::endl;
+    else
+        out << std::scientific << std::setprecision(3)
+            << "  float - double: max " << max_diff << ", RMS " << rms_diff << std::fixed << std::setprecision(1)
+            << " (" << 20. * log10(rms_diff / std::max(rms_sig, 1e-300)) << " dB relative to the output RMS, "
+            << "16bit LSB is " << 20. * log10(1. / 32768. / std::max(rms_sig, 1e-300)) << " dB)" << std::endl;
+
+    // Streaming interface in calls of an audio callback size: the latency and the longest call,
+    // which has to stay well below the duration of the call.
+    PathSimProcessor<float> processor;
+    processor.init(params, sample_rate);
+    out << std::fixed << "streaming: blocks of " << processor.block_size() << " samples, calls of " << STREAM_FRAMES
+        << " samples (" << std::setprecision(2) << STREAM_FRAMES * 1000. / sample_rate << " ms), latency "
+        << processor.latency() << " samples = " << std::setprecision(1) << processor.latency() * 1000. / sample_rate
+        << " ms, measured " << measure_latency<float>(params, sample_rate) << " samples" << std::endl;
+    double longest_double, longest_float;
+    double s_double = benchmark_stream<double>(params, input, sample_rate, longest_double);
+    double s_float  = benchmark_stream<float> (params, input, sample_rate, longest_float);
+    report_throughput(out, "double", s_double, input.size(), sample_rate);
+    out << "    longest call " << std::setprecision(1) << longest_double * 1e6 << " us" << std::endl;
+    report_throughput(out, "float", s_float, input.size(), sample_rate);
+    out << "    longest call " << std::setprecision(1) << longest_float * 1e6 << " us" << std::endl;
+
+    // The same through the pipelined stages, then the counters of the stages of one more float run:
+    // the bottleneck is the stage with the most busy time, the stages after it stall waiting for it.
+    {
+        typedef PipelinedProcessor<float> Pipelined;
+        Pipelined pipelined;
+        pipelined.init(params, sample_rate);
+        out << "pipelined: " << int(Pipelined::STAGE_OUTPUT) << " stage threads, depth " << Pipelined::DEFAULT_DEPTH
+            << " blocks, latency " << pipelined.latency() << " samples = " << std::setprecision(1) << pipelined.latency() * 1000. / sample_rate
+            << " ms, measured " << measure_latency<float, PipelinedProcessor>(params, sample_rate) << " samples" << std::endl;
+        double p_double = benchmark_stream<double, PipelinedProcessor>(params, input, sample_rate, longest_double);
+        double p_float  = benchmark_stream<float,  PipelinedProcessor>(params, input, sample_rate, longest_float);
+        report_throughput(out, "double", p_double, input.size(), sample_rate);
+        out << "    longest call " << std::setprecision(1) << longest_double * 1e6 << " us" << std::endl;
+        report_throughput(out, "float", p_float, input.size(), sample_rate);
+        out << "    longest call " << std::setprecision(1) << longest_float * 1e6 << " us" << std::endl;
+        std::vector<float> signal(input.begin(), input.end());
+        for (size_t i = 0; i < signal.size(); i += STREAM_FRAMES)
+            pipelined.process(signal.data() + i, signal.data() + i, std::min<size_t>(STREAM_FRAMES, signal.size() - i));
+        out << "  stage       blocks  stalls   wait ms   busy ms   queue mean  max" << std::endl;
+        for (const Pipelined::StageStats &s : pipelined.stats())
+            out << "  " << std::left << std::setw(10) << s.name << std::right
+                << std::setw(8) << s.blocks << std::setw(8) << s.stalls
+                << std::setw(10) << std::setprecision(3) << s.wait * 1000. << std::setw(10) << s.busy * 1000.
+                << std::setw(13) << std::setprecision(2) << s.mean_depth << std::setw(5) << s.max_depth << std::endl;
+    }
+
+    // The simulation at 8 kHz with the input and the output resampled, streamed the same way,
+    // and the cost of the resamplers alone.
+    if (sample_rate == double(ResamplingProcessor<float>::INTERNAL_SAMPLE_RATE))
+        return;
+    ResamplingProcessor<float> resampling;
+    resampling.init(params, sample_rate);
+    const Resampler<float> &down = resampling.down_converter();
+    const Resampler<float> &up   = resampling.up_converter();
+    out << "resampled to " << ResamplingProcessor<float>::INTERNAL_SAMPLE_RATE << " Hz: "
+        << down.up() << "/" << down.down() << " by " << down.taps() << " taps per phase, "
+        << up.up() << "/" << up.down() << " by " << up.taps() << " taps per phase, latency "
+        << resampling.latency() << " samples = " << std::setprecision(1) << resampling.latency() * 1000. / sample_rate
+        << " ms, measured " << measure_latency<float, ResamplingProcessor>(params, sample_rate) << " samples" << std::endl;
+    double r_double = benchmark_stream<double, ResamplingProcessor>(params, input, sample_rate, longest_double);
+    double r_float  = benchmark_stream<float,  ResamplingProcessor>(params, input, sample_rate, longest_float);
+    report_throughput(out, "double", r_double, input.size(), sample_rate);
+    out << "    longest call " << std::setprecision(1) << longest_double * 1e6 << " us" << std::endl;
+    report_throughput(out, "float", r_float, input.size(), sample_rate);
+    out << "    longest call " << std::setprecision(1) << longest_float * 1e6 << " us" << std::endl;
+    out << "  float speedup over the native rate " << std::setprecision(2) << s_float / r_float << "x" << std::endl;
+    ResamplingProcessor<double> resampling_double;
+    resampling_double.init(params, sample_rate);
+    double c_double = benchmark_resamplers<double>(resampling_double, input);
+    double c_float  = benchmark_resamplers<float> (resampling, input);
+    out << "  of that the resamplers, down and up:" << std::endl;
+    report_throughput(out, "double", c_double, input.size(), sample_rate);
+    report_throughput(out, "float", c_float, input.size(), sample_rate);
+}
+
+} // namespace PathSim
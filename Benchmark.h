@@ -0,0 +1,23 @@
+// Throughput and accuracy benchmark of the simulator.
+
+#ifndef PATHSIM_BENCHMARK_HPP
+#define PATHSIM_BENCHMARK_HPP
+
+#include <ostream>
+#include <vector>
+
+#include "PathSimParams.h"
+
+namespace PathSim {
+
+// Process the input by the double and by the single precision chain, report the throughput
+// of both and the difference of the single precision output from the double precision one.
+// Then report the latency and the throughput of the streaming interface in audio callback sized calls,
+// and the same for the pipelined processor with the counters of its stages.
+// At other sample rates than 8 kHz the same for the simulation at 8 kHz with resampled input and output,
+// and the cost of the resampling alone.
+extern void run_benchmark(const PathSimParams &params, const std::vector<double> &input, double sample_rate, std::ostream &out);
+
+} // namespace PathSim
+
+#endif // PATHSIM_BENCHMARK_HPP
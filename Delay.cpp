@@ -2,63 +2,267 @@
 //   ( also performs Hilbert Real to complex I/Q 3KHz filtering )
 
 #include "Delay.h"
+#include "FilterDesign.h"
 #include "FilterTables.h"
+#include "Simd.h"
+
+#include <string.h>
+#include <algorithm>
 
 namespace PathSim {
 
-void Hilbert::init()
+// The history is rounded up to a multiple of this number of samples, 64 bytes of floats.
+static constexpr int HISTORY_ALIGN = 16;
+// Minimum length of the blocks part of the delay line in multiples of the history.
+static constexpr int MIN_SPAN_HISTORIES = 4;
+
+template<typename T>
+void Hilbert<T>::init(int taps, double sample_rate, int blocksize)
 {
-	memset(m_hilbert_queue, 0, sizeof(m_hilbert_queue));
-	m_hilbert_ptr = HILBPFIR_LENGTH - 1;
+	m_block_size = std::max(1, std::min(BLOCKSIZE, blocksize));
+	const ComplexCoefs &coefs = channel_filter(taps, sample_rate);
+	const std::vector<double> &coef_i = coefs.re;
+	const std::vector<double> &coef_q = coefs.im;
+	m_taps = int(coef_i.size());
+	m_history.assign(m_taps - 1 + m_block_size, T(0));
+
+	if (this->fft_mode()) {
+		// Smallest FFT holding the history and the new block, so that the circular convolution
+		// does not wrap into the output samples.
+		int fft_size = 1;
+		while (fft_size < m_taps - 1 + m_block_size)
+			fft_size <<= 1;
+		m_fft.init(fft_size);
+		// The spectrum is calculated in double precision even for the single precision filter.
+		FFT<double> fft;
+		fft.init(fft_size);
+		std::vector<double> spectrum_re(fft_size, 0.), spectrum_im(fft_size, 0.);
+		for (int i = 0; i < m_taps; ++ i) {
+			spectrum_re[i] = coef_i[i] / fft_size;
+			spectrum_im[i] = coef_q[i] / fft_size;
+		}
+		fft.forward(spectrum_re.data(), spectrum_im.data());
+		m_spectrum_re.assign(spectrum_re.begin(), spectrum_re.end());
+		m_spectrum_im.assign(spectrum_im.begin(), spectrum_im.end());
+		m_fft_re.assign(fft_size, T(0));
+		m_fft_im.assign(fft_size, T(0));
+		m_coef_i.clear();
+		m_coef_q.clear();
+	} else {
+		m_coef_i.assign(coef_i.rbegin(), coef_i.rend());
+		m_coef_q.assign(coef_q.rbegin(), coef_q.rend());
+		m_spectrum_re.clear();
+		m_spectrum_im.clear();
+		m_fft_re.clear();
+		m_fft_im.clear();
+	}
 }
 
 // Hilbert 3KHz BP filters.  Real input and complex I/Q output
 //   This FIR bandwidth limits the real input as well as creates a
 //   complex I/Q output signal for the rest of the processing chain.
-void Hilbert::filter_block(const double* pIn, cmplx* pOut)
+//   The I filter is the band pass modulated by a cosine, the Q filter by a sine,
+//   so that I + jQ is the analytic signal containing just the positive frequencies.
+template<typename T>
+void Hilbert<T>::filter_block(const T* pIn, cmplx_block<T> out)
+{
+	const int history = m_taps - 1;
+	memcpy(m_history.data() + history, pIn, m_block_size * sizeof(T));
+	if (this->fft_mode())
+		this->filter_block_fft(out);
+	else
+		this->filter_block_direct(out);
+	// Keep the tail of this block for the next one.
+	memmove(m_history.data(), m_history.data() + m_block_size, history * sizeof(T));
+}
+
+// Both filters are applied in a single vectorized pass over the linear history buffer,
+// writing the I and Q planes of the output block directly.
+template<typename T>
+void Hilbert<T>::filter_block_direct(cmplx_block<T> out)
+{
+	fir_block2(m_history.data(), m_coef_i.data(), m_coef_q.data(), m_taps, out.r, out.i, m_block_size);
+}
+
+// Overlap-save: the history and the new block are convolved with the complex filter
+// in the frequency domain, the first m_taps - 1 output samples are discarded as they
+// are aliased by the circular convolution.
+template<typename T>
+void Hilbert<T>::filter_block_fft(cmplx_block<T> out)
 {
-	for (int i = 0; i < BLOCKSIZE; ++ i) {
-		m_hilbert_queue[m_hilbert_ptr].set(pIn[i], pIn[i]);	//place real values in circular Queue
-		const cmplx* Firptr = m_hilbert_queue;
-		const double* IKptr = IHilbertBPFirCoef+HILBPFIR_LENGTH-m_hilbert_ptr;
-		const double* QKptr = QHilbertBPFirCoef+HILBPFIR_LENGTH-m_hilbert_ptr;
-		cmplx acc{0., 0.};
-		for (int j = 0; j < HILBPFIR_LENGTH; ++ j, ++ Firptr)
-			acc += (*Firptr) * (*IKptr++);
-		pOut[i] = acc;
-		if (-- m_hilbert_ptr < 0)
-			m_hilbert_ptr = HILBPFIR_LENGTH - 1;
+	const int len = m_taps - 1 + m_block_size;
+	const int size = m_fft.size();
+	T *re = m_fft_re.data();
+	T *im = m_fft_im.data();
+	memcpy(re, m_history.data(), len * sizeof(T));
+	std::fill(re + len, re + size, T(0));
+	std::fill(im, im + size, T(0));
+	m_fft.forward(re, im);
+	const T *sr = m_spectrum_re.data();
+	const T *si = m_spectrum_im.data();
+	for (int i = 0; i < size; ++ i) {
+		T r = re[i] * sr[i] - im[i] * si[i];
+		im[i] = re[i] * si[i] + im[i] * sr[i];
+		re[i] = r;
 	}
+	m_fft.inverse(re, im);
+	memcpy(out.r, re + m_taps - 1, m_block_size * sizeof(T));
+	memcpy(out.i, im + m_taps - 1, m_block_size * sizeof(T));
 }
 
-void Delay::init()
+template<typename T>
+void Delay<T>::init(double sample_rate, int blocksize)
 {
-	memset(m_delay_line, 0, sizeof(m_delay_line));
-	m_in_ptr = BUFSIZE - 1;
-	m_out_ptrs.clear();
+	m_block_size 	 = std::max(1, std::min(BLOCKSIZE, blocksize));
+	m_samples_per_ms = sample_rate / 1000.;
+	m_max_delay 	 = int(MAXDELAY_MS * m_samples_per_ms + 0.5);
+	m_history 		 = (m_max_delay + FD_TAPS + HISTORY_ALIGN - 1) / HISTORY_ALIGN * HISTORY_ALIGN;
+	// At least m_history samples of blocks, so that the moved history does not overlap its new position.
+	const int min_span = MIN_SPAN_HISTORIES * m_history;
+	const int blocks = std::max(1, (min_span + m_block_size - 1) / m_block_size);
+	m_span = blocks * m_block_size;
+	m_pos  = 0;
+	m_arena.init(1, m_history + m_span);
+	m_line = m_arena.block(0);
+	m_taps.clear();
+	m_interpolated.init(0, m_block_size);
 }
 
-void Delay::add_delay(double time_ms)
+template<typename T>
+int Delay<T>::add_delay(double time_ms, double rate_ms_per_s)
 {
-	m_out_ptrs.emplace_back(int(BUFSIZE - int(8.0 * time_ms) - 1));
+	Tap tap;
+	double delay = m_samples_per_ms * time_ms;
+	double whole = floor(delay + 0.5);
+	if (rate_ms_per_s == 0. && fabs(delay - whole) < 1e-6) {
+		// Whole number of samples, read in place.
+		tap.whole = std::max(0, std::min(m_max_delay, int(whole)));
+	} else {
+		if (m_fd_re.empty()) {
+			const ComplexCoefs &coefs = channel_farrow_delay(FD_TAPS, FD_ORDER, 1000. * m_samples_per_ms);
+			m_fd_re.assign(coefs.re.begin(), coefs.re.end());
+			m_fd_im.assign(coefs.im.begin(), coefs.im.end());
+		}
+		tap.interpolated = true;
+		tap.delay = std::max<double>(MINDELAY_INTERPOLATED, std::min<double>(m_max_delay, delay));
+		// ms of delay per s of time is 1e-3 samples of delay per sample at any sample rate.
+		tap.rate  = 1e-3 * rate_ms_per_s;
+	}
+	m_taps.emplace_back(tap);
+	m_interpolated.init(int(m_taps.size()), m_block_size);
+	return int(m_taps.size()) - 1;
+}
+
+template<typename T>
+void Delay<T>::interpolate()
+{
+	for (int i = 0; i < int(m_taps.size()); ++ i)
+		if (m_taps[i].interpolated)
+			this->interpolate_tap(m_taps[i], m_interpolated.block(i));
 }
 
-// Uses pointers to create variable delays
-void Delay::delay_block(const std::vector<cmplx> &inbuf, std::vector<std::vector<cmplx>*> &out_buffers)
+// Fractional delay by a Farrow structure interpolator: for a delay of n + d samples, 0 <= d < 1,
+// the output is a polynomial in d, its coefficients being outputs of fixed complex FIR filters
+// of the samples around the n samples delayed input. The filters are designed for the band
+// of the analytic signal only (see design_farrow_delay()), which keeps them short.
+// The block is split into runs of the same whole samples delay n, over which d changes
+// linearly, so each run is a plain loop over the samples that vectorizes.
+// For a constant delay the polynomial collapses to a single FIR filter of FD_TAPS complex taps.
+template<typename T>
+void Delay<T>::interpolate_tap(Tap &tap, cmplx_block<T> out)
 {
-    for (int i = 0; i < BLOCKSIZE; ++ i) {
-		// Copy new data from inbuf into delay buffer
-		m_delay_line[m_in_ptr ++] = inbuf[i];
-		if (m_in_ptr >= BUFSIZE)
-			m_in_ptr = 0;
-		// Delay to the output buffers.
-		for (int j = 0; j < m_out_ptrs.size(); ++ j) {
-			int& ptr = m_out_ptrs[j];
-			(*out_buffers[j])[i] = m_delay_line[ptr ++];
-			if (ptr >= BUFSIZE)
-				ptr = 0;
+	// A drifting delay stops at the limits: the last block ramps to the limit.
+	double rate = tap.rate;
+	double end  = tap.delay + rate * m_block_size;
+	if (end > m_max_delay || end < MINDELAY_INTERPOLATED) {
+		end 	 = std::max<double>(MINDELAY_INTERPOLATED, std::min<double>(m_max_delay, end));
+		rate 	 = (end - tap.delay) / m_block_size;
+		tap.rate = 0.;
+	}
+	// Local copy of the coefficients, so the compiler does not reload them after each store to out.
+	T cr[FD_ORDER + 1][FD_TAPS];
+	T ci[FD_ORDER + 1][FD_TAPS];
+	for (int k = 0; k <= FD_ORDER; ++ k)
+		for (int m = 0; m < FD_TAPS; ++ m) {
+			cr[k][m] = m_fd_re[k * FD_TAPS + m];
+			ci[k][m] = m_fd_im[k * FD_TAPS + m];
+		}
+	for (int i = 0; i < m_block_size;) {
+		const double delay = tap.delay + rate * i;
+		const int    whole = std::min(m_max_delay, int(delay));
+		// Number of samples until the delay crosses to the next whole sample.
+		double run = rate > 0. ? ceil((whole + 1 - delay) / rate) : rate < 0. ? floor((delay - whole) / - rate) + 1. : m_block_size;
+		const int n = int(std::max(1., std::min<double>(m_block_size - i, run)));
+		const T   d0   = T(delay - whole);
+		const T   step = T(rate);
+		// xr[k - m] is the sample delayed by whole + m - (FD_TAPS / 2 - 1) samples.
+		const T  *xr   = m_line.r + m_history + m_pos - whole + i + FD_TAPS / 2 - 1;
+		const T  *xi   = m_line.i + m_history + m_pos - whole + i + FD_TAPS / 2 - 1;
+		T *yr = out.r + i;
+		T *yi = out.i + i;
+		if (rate == 0.) {
+			// Constant delay, evaluate the polynomial for the taps once.
+			T hr[FD_TAPS];
+			T hi[FD_TAPS];
+			for (int m = 0; m < FD_TAPS; ++ m) {
+				hr[m] = cr[FD_ORDER][m];
+				hi[m] = ci[FD_ORDER][m];
+				for (int o = FD_ORDER - 1; o >= 0; -- o) {
+					hr[m] = hr[m] * d0 + cr[o][m];
+					hi[m] = hi[m] * d0 + ci[o][m];
+				}
+			}
+			for (int k = 0; k < n; ++ k) {
+				T sr = 0;
+				T si = 0;
+				for (int m = 0; m < FD_TAPS; ++ m) {
+					sr += hr[m] * xr[k - m] - hi[m] * xi[k - m];
+					si += hr[m] * xi[k - m] + hi[m] * xr[k - m];
+				}
+				yr[k] = sr;
+				yi[k] = si;
+			}
+		} else {
+			// Horner scheme over the polynomial orders, each order is one pass over the run.
+			for (int o = FD_ORDER; o >= 0; -- o) {
+				const T *pr = cr[o];
+				const T *pi = ci[o];
+				for (int k = 0; k < n; ++ k) {
+					T sr = 0;
+					T si = 0;
+					for (int m = 0; m < FD_TAPS; ++ m) {
+						sr += pr[m] * xr[k - m] - pi[m] * xi[k - m];
+						si += pr[m] * xi[k - m] + pi[m] * xr[k - m];
+					}
+					const T d = d0 + step * T(k);
+					yr[k] = (o == FD_ORDER) ? sr : yr[k] * d + sr;
+					yi[k] = (o == FD_ORDER) ? si : yi[k] * d + si;
+				}
+			}
 		}
+		i += n;
 	}
+	tap.delay = end;
 }
 
+// The delay line is linear, so each delayed block is a contiguous window of the line ending
+// a delay before the current block end. The paths read the windows in place and the only
+// data movement is copying the history tail back to the start of the line once it is full.
+template<typename T>
+void Delay<T>::advance()
+{
+	m_pos += m_block_size;
+	if (m_pos + m_block_size > m_span) {
+		// m_pos == m_span >= m_history, the source and the destination do not overlap.
+		memcpy(m_line.r, m_line.r + m_pos, m_history * sizeof(T));
+		memcpy(m_line.i, m_line.i + m_pos, m_history * sizeof(T));
+		m_pos = 0;
+	}
+}
+
+template class Hilbert<float>;
+template class Hilbert<double>;
+template class Delay<float>;
+template class Delay<double>;
+
 } // namespace PathSim
@@ -4,40 +4,129 @@
 #include <math.h>
 #include <vector>
 
+#include "Arena.h"
 #include "cmplx.h"
+#include "FFT.h"
 #include "FilterTables.h"
 
 namespace PathSim {
 
+template<typename T>
 class Hilbert
 {
 public:
+    // Default and maximum number of samples per block.
     static constexpr int BLOCKSIZE  = 2048;
+    // Filters of at least this length are evaluated by FFT (overlap-save), shorter ones directly.
+    // Break even point of the two engines measured at 2048 samples per block.
+#ifdef __AVX2__
+    static constexpr int FFT_MIN_TAPS = 256;
+#else
+    static constexpr int FFT_MIN_TAPS = 96;
+#endif
 
-    void init();
-    void filter_block(const double* pIn, cmplx* pOut);
+    // taps == 0: the built-in 59 tap filter at 8 kHz or a filter of the same duration at other sample rates,
+    // otherwise a band pass of the same shape with given number of taps, see channel_filter().
+    // filter_block() processes blocksize samples, 1 to BLOCKSIZE.
+    void init(int taps, double sample_rate, int blocksize = BLOCKSIZE);
+    void filter_block(const T* pIn, cmplx_block<T> out);
+
+    int  taps() const { return m_taps; }
+    // Group delay of the linear phase filter in samples.
+    int  group_delay() const { return (m_taps - 1) / 2; }
+    bool fft_mode() const { return m_taps >= FFT_MIN_TAPS; }
 
 private:
-    cmplx m_hilbert_queue[HILBPFIR_LENGTH];
-    int   m_hilbert_ptr = 0;
+    void filter_block_direct(cmplx_block<T> out);
+    void filter_block_fft(cmplx_block<T> out);
+
+    int                 m_taps { 0 };
+    int                 m_block_size { BLOCKSIZE };
+    // Linear history: m_taps - 1 samples of the previous block followed by the current block.
+    std::vector<T>      m_history;
+
+    // Direct form: I and Q filter coefficients in reversed order for the block FIR kernel.
+    std::vector<T>      m_coef_i;
+    std::vector<T>      m_coef_q;
+
+    // Overlap-save: spectrum of the complex I + jQ filter scaled by 1 / FFT size, FFT work buffer,
+    // real and imaginary parts.
+    FFT<T>              m_fft;
+    std::vector<T>      m_spectrum_re;
+    std::vector<T>      m_spectrum_im;
+    std::vector<T>      m_fft_re;
+    std::vector<T>      m_fft_im;
 };
 
+template<typename T>
 class Delay
 {
 public:
     // 50mSecs max delay
-    static constexpr int MAXDELAY   = 50 * 8;
-    static constexpr int BLOCKSIZE  = Hilbert::BLOCKSIZE;
-    static constexpr int BUFSIZE    = BLOCKSIZE + MAXDELAY;
+    static constexpr int MAXDELAY_MS = 50;
+    static constexpr int BLOCKSIZE  = Hilbert<T>::BLOCKSIZE;
+    // Fractional delay interpolator: number of taps and order of the Farrow polynomial.
+    static constexpr int FD_TAPS    = 6;
+    static constexpr int FD_ORDER   = 5;
+    // Shortest delay of an interpolated tap: the interpolator reads FD_TAPS / 2 - 1 samples ahead.
+    static constexpr int MINDELAY_INTERPOLATED = FD_TAPS / 2 - 1;
+
+    // blocksize: samples per block, 1 to BLOCKSIZE.
+    void init(double sample_rate, int blocksize = BLOCKSIZE);
+    // Add a tap delayed by time_ms, changing by rate_ms_per_s, returns index of the tap.
+    // Taps with a whole number of samples delay and no drift are views into the delay line,
+    // the other ones are interpolated. A drifting delay stops at the limits of the delay line.
+    int  add_delay(double time_ms, double rate_ms_per_s = 0.);
 
-    void init();
-    void add_delay(double time_ms);
-    void delay_block(const std::vector<cmplx> &inbuf, std::vector<std::vector<cmplx>*> &out_buffers);
+    // Block to receive the next block of input samples.
+    cmplx_block<T>       input_block() { return { m_line.r + m_history + m_pos, m_line.i + m_history + m_pos }; }
+    // Calculate the interpolated taps of the current block, to be called once input_block() is filled.
+    void interpolate();
+    // Read only view of the current input block delayed by the idx-th tap.
+    // Valid until advance(), the path kernels read the delayed input in place.
+    cmplx_block<const T> tap(int idx) const
+    {
+        const Tap &tap = m_taps[idx];
+        return tap.interpolated ? m_interpolated.block(idx) :
+            cmplx_block<const T>{ m_line.r + m_history + m_pos - tap.whole, m_line.i + m_history + m_pos - tap.whole };
+    }
+    // Retire the current block, it becomes a part of the history of the next one.
+    void advance();
 
 private:
-    cmplx 	m_delay_line[BUFSIZE];
-    int 	m_in_ptr = 0;
-    std::vector<int> m_out_ptrs;
+    struct Tap {
+        // Delay of the first sample of the current block in samples, its change per sample.
+        double  delay           { 0. };
+        double  rate            { 0. };
+        // Whole samples delay of a tap, which is not interpolated.
+        int     whole           { 0 };
+        bool    interpolated    { false };
+    };
+    void interpolate_tap(Tap &tap, cmplx_block<T> out);
+
+    int                 m_block_size { BLOCKSIZE };
+    double              m_samples_per_ms { 8. };
+    // Longest delay in samples, MAXDELAY_MS at the sample rate.
+    int                 m_max_delay { 0 };
+    // History kept before the current block: m_max_delay plus the older samples read by the interpolator,
+    // rounded up so that the current block starts at a cache line boundary.
+    int                 m_history { 0 };
+    // Linear delay line, I and Q planes: m_history samples followed by m_span samples of the blocks.
+    // The current block starts m_pos samples after the history. When the line is full,
+    // the last m_history samples are moved back to its start. Small blocks get a line of several
+    // blocks, so that the move is amortized over them: it happens once per at least 4 x m_history
+    // samples, a block of BLOCKSIZE at 8 kHz moves the history once per block.
+    Arena<T>            m_arena;
+    cmplx_block<T>      m_line;
+    int                 m_span  { 0 };
+    int                 m_pos   { 0 };
+    std::vector<Tap>    m_taps;
+    // Output of the interpolated taps, one block per tap, unused for the taps read in place.
+    Arena<T>            m_interpolated;
+    // Farrow coefficients of the interpolator, real and imaginary parts, FD_TAPS per polynomial order.
+    // Designed when the first interpolated tap is added.
+    std::vector<T>      m_fd_re;
+    std::vector<T>      m_fd_im;
 };
 
 } // namespace PathSim
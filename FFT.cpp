@@ -0,0 +1,124 @@
+// Radix-2 complex FFT used by the overlap-save convolution.
+
+#include "FFT.h"
+
+#include <assert.h>
+#include <math.h>
+
+namespace PathSim {
+
+static constexpr double PI2 = 6.283185307179586476925286766559;
+
+template<typename T>
+void FFT<T>::init(int size)
+{
+	assert(size >= 4 && (size & (size - 1)) == 0);
+	m_size = size;
+	m_twiddles_re.clear();
+	m_twiddles_im.clear();
+	m_twiddles_im_inv.clear();
+	for (int len = 2; len <= size; len <<= 1)
+		for (int k = 0; k < len / 2; ++ k) {
+			double phi = PI2 * double(k) / double(len);
+			m_twiddles_re.push_back(T(cos(phi)));
+			m_twiddles_im.push_back(T(- sin(phi)));
+			m_twiddles_im_inv.push_back(T(sin(phi)));
+		}
+}
+
+// The butterflies of a stage are a plain loop over contiguous arrays of the split real and
+// imaginary parts, which vectorizes. The arrays do not overlap, which is declared to spare
+// the compiler the run time alias checks of the six arrays, too many for it to version the loop.
+
+// Decimation in frequency butterflies of n pairs (a, b) with twiddle factors w: a + b, (a - b) w.
+template<typename T>
+static void butterflies_dif(T * __restrict ar, T * __restrict ai, T * __restrict br, T * __restrict bi,
+	const T * __restrict wr, const T * __restrict wi, int n)
+{
+	for (int k = 0; k < n; ++ k) {
+		T dr = ar[k] - br[k];
+		T di = ai[k] - bi[k];
+		ar[k] += br[k];
+		ai[k] += bi[k];
+		br[k] = dr * wr[k] - di * wi[k];
+		bi[k] = dr * wi[k] + di * wr[k];
+	}
+}
+
+// Decimation in time butterflies of n pairs (a, b) with twiddle factors w: a + w b, a - w b.
+template<typename T>
+static void butterflies_dit(T * __restrict ar, T * __restrict ai, T * __restrict br, T * __restrict bi,
+	const T * __restrict wr, const T * __restrict wi, int n)
+{
+	for (int k = 0; k < n; ++ k) {
+		T tr = br[k] * wr[k] - bi[k] * wi[k];
+		T ti = br[k] * wi[k] + bi[k] * wr[k];
+		br[k] = ar[k] - tr;
+		bi[k] = ai[k] - ti;
+		ar[k] += tr;
+		ai[k] += ti;
+	}
+}
+
+// Decimation in frequency: natural order in, bit reversed order out.
+// The last two stages have trivial twiddle factors 1 and -j and run as a single radix-4 pass.
+template<typename T>
+void FFT<T>::forward(T *re, T *im) const
+{
+	for (int len = m_size; len >= 8; len >>= 1) {
+		const int half = len / 2;
+		for (int i = 0; i < m_size; i += len)
+			butterflies_dif(re + i, im + i, re + i + half, im + i + half,
+				m_twiddles_re.data() + half - 1, m_twiddles_im.data() + half - 1, half);
+	}
+	for (int i = 0; i < m_size; i += 4) {
+		// Stage of len 4: (x1 - x3) is multiplied by -j.
+		T r0 = re[i] + re[i + 2], i0 = im[i] + im[i + 2];
+		T r2 = re[i] - re[i + 2], i2 = im[i] - im[i + 2];
+		T r1 = re[i + 1] + re[i + 3], i1 = im[i + 1] + im[i + 3];
+		T r3 = im[i + 1] - im[i + 3], i3 = re[i + 3] - re[i + 1];
+		// Stage of len 2.
+		re[i]     = r0 + r1;
+		im[i]     = i0 + i1;
+		re[i + 1] = r0 - r1;
+		im[i + 1] = i0 - i1;
+		re[i + 2] = r2 + r3;
+		im[i + 2] = i2 + i3;
+		re[i + 3] = r2 - r3;
+		im[i + 3] = i2 - i3;
+	}
+}
+
+// Decimation in time: bit reversed order in, natural order out.
+// The first two stages have trivial twiddle factors 1 and j and run as a single radix-4 pass.
+template<typename T>
+void FFT<T>::inverse(T *re, T *im) const
+{
+	for (int i = 0; i < m_size; i += 4) {
+		// Stage of len 2.
+		T r0 = re[i] + re[i + 1], i0 = im[i] + im[i + 1];
+		T r1 = re[i] - re[i + 1], i1 = im[i] - im[i + 1];
+		T r2 = re[i + 2] + re[i + 3], i2 = im[i + 2] + im[i + 3];
+		T r3 = re[i + 2] - re[i + 3], i3 = im[i + 2] - im[i + 3];
+		// Stage of len 4: (r3 + j i3) is multiplied by j.
+		re[i]     = r0 + r2;
+		im[i]     = i0 + i2;
+		re[i + 2] = r0 - r2;
+		im[i + 2] = i0 - i2;
+		re[i + 1] = r1 - i3;
+		im[i + 1] = i1 + r3;
+		re[i + 3] = r1 + i3;
+		im[i + 3] = i1 - r3;
+	}
+	for (int len = 8; len <= m_size; len <<= 1) {
+		const int half = len / 2;
+		for (int i = 0; i < m_size; i += len)
+			butterflies_dit(re + i, im + i, re + i + half, im + i + half,
+				m_twiddles_re.data() + half - 1, m_twiddles_im_inv.data() + half - 1, half);
+	}
+}
+
+template class FFT<float>;
+template class FFT<double>;
+
+} // namespace PathSim
@@ -0,0 +1,40 @@
+// Radix-2 complex FFT used by the overlap-save convolution.
+
+#ifndef PATHSIM_FFT_HPP
+#define PATHSIM_FFT_HPP
+
+#include <vector>
+
+namespace PathSim {
+
+template<typename T>
+class FFT
+{
+public:
+	// size has to be a power of two, at least 4.
+	void 	init(int size);
+	int 	size() const { return m_size; }
+
+	// In place transforms of the complex data split into the real parts re and the imaginary parts im.
+	// The spectrum is kept in the bit reversed order: forward() takes the signal in the natural order
+	// and leaves the spectrum bit reversed, inverse() takes the bit reversed spectrum and returns
+	// the signal in the natural order. That is all a convolution needs, the filter spectrum being
+	// in the same order, and the transforms are spared the permutation.
+	// The inverse transform is not scaled by 1 / size.
+	void 	forward(T *re, T *im) const;
+	void 	inverse(T *re, T *im) const;
+
+private:
+	int 				m_size { 0 };
+	// Twiddle factors of all the butterfly stages stored one after the other, so that each stage
+	// reads them sequentially: exp(-j 2 pi k / len) for len = 2, 4, .. size and k = 0 .. len / 2 - 1,
+	// the stage of len starts at index len / 2 - 1. The real parts are shared by both directions,
+	// m_twiddles_im_inv are the imaginary parts of the complex conjugates for the inverse transform.
+	std::vector<T> 		m_twiddles_re;
+	std::vector<T> 		m_twiddles_im;
+	std::vector<T> 		m_twiddles_im_inv;
+};
+
+} // namespace PathSim
+
+#endif // PATHSIM_FFT_HPP
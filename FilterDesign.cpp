@@ -0,0 +1,211 @@
+// Windowed sinc FIR filter design, least squares fractional delay design,
+// cached filters of the simulated channel for any sample rate.
+
+#include "FilterDesign.h"
+#include "FilterTables.h"
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <complex>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+namespace PathSim {
+
+static constexpr double PI = 3.1415926535897932384626433832795;
+
+// Stop band attenuation of the designed Hilbert band pass filters, dB.
+static constexpr double HILBERT_ATTENUATION = 60.;
+// The fractional delay interpolator is designed for the channel pass band widened by this margin, Hz.
+static constexpr double FD_BAND_MARGIN = 100.;
+
+// Zeroth order modified Bessel function of the first kind.
+static double bessel_i0(double x)
+{
+	double sum  = 1.;
+	double term = 1.;
+	for (int k = 1; k < 50; ++ k) {
+		term *= (x / (2. * k)) * (x / (2. * k));
+		sum  += term;
+		if (term < 1e-12 * sum)
+			break;
+	}
+	return sum;
+}
+
+double kaiser_beta(double attenuation_db)
+{
+	if (attenuation_db > 50.)
+		return 0.1102 * (attenuation_db - 8.7);
+	if (attenuation_db >= 21.)
+		return 0.5842 * pow(attenuation_db - 21., 0.4) + 0.07886 * (attenuation_db - 21.);
+	return 0.;
+}
+
+double kaiser_transition_width(int taps, double sample_rate, double attenuation_db)
+{
+	assert(taps > 1);
+	return (attenuation_db - 7.95) / (14.36 * double(taps - 1)) * sample_rate;
+}
+
+int kaiser_taps(double transition_width, double sample_rate, double attenuation_db)
+{
+	return int(ceil((attenuation_db - 7.95) * sample_rate / (14.36 * transition_width))) + 1;
+}
+
+std::vector<double> design_lowpass(int taps, double sample_rate, double cutoff, double beta)
+{
+	std::vector<double> coef(taps, 0.);
+	double fc     = cutoff / sample_rate;
+	double center = 0.5 * double(taps - 1);
+	double norm   = 1. / bessel_i0(beta);
+	double sum    = 0.;
+	for (int k = 0; k < taps; ++ k) {
+		double t = double(k) - center;
+		double sinc = (t == 0.) ? 2. * fc : sin(2. * PI * fc * t) / (PI * t);
+		double r = (taps > 1) ? t / center : 0.;
+		coef[k] = sinc * bessel_i0(beta * sqrt(std::max(0., 1. - r * r))) * norm;
+		sum += coef[k];
+	}
+	// Unity DC gain.
+	for (double &c : coef)
+		c /= sum;
+	return coef;
+}
+
+void design_hilbert_bandpass(int taps, double sample_rate, double center_freq, double half_bandwidth,
+	std::vector<double> &coef_i, std::vector<double> &coef_q)
+{
+	// Place the -6dB point in the middle of the transition band.
+	double cutoff = half_bandwidth + 0.5 * kaiser_transition_width(taps, sample_rate, HILBERT_ATTENUATION);
+	std::vector<double> lp = design_lowpass(taps, sample_rate, cutoff, kaiser_beta(HILBERT_ATTENUATION));
+	double w0     = 2. * PI * center_freq / sample_rate;
+	double center = 0.5 * double(taps - 1);
+	coef_i.assign(taps, 0.);
+	coef_q.assign(taps, 0.);
+	for (int k = 0; k < taps; ++ k) {
+		double phi = w0 * (double(k) - center);
+		coef_i[k] = 2. * lp[k] * cos(phi);
+		coef_q[k] = 2. * lp[k] * sin(phi);
+	}
+}
+
+void design_farrow_delay(int taps, int order, double sample_rate, double f_low, double f_high,
+	std::vector<double> &coef_re, std::vector<double> &coef_im)
+{
+	typedef std::complex<double> complex;
+	// Least squares grid: frequencies over the band, fractional delays over <0, 1>.
+	const int num_freqs  = 2 * taps * (order + 1);
+	const int num_delays = 4 * (order + 1);
+	const int n          = taps * (order + 1);
+	// Over-determined system A x = b, one row per grid point, the unknown x[k * taps + m] multiplies d^k x[n - t_m].
+	// At high sample rates the band is narrow and the columns of A are nearly dependent, thus the system
+	// is solved by the Householder QR decomposition rather than by the normal equations, which square
+	// the condition number.
+	const int rows = (num_freqs + 1) * (num_delays + 1);
+	std::vector<complex> a(size_t(rows) * n), b(rows);
+	for (int i = 0, r = 0; i <= num_freqs; ++ i) {
+		double w = 2. * PI * (f_low + (f_high - f_low) * i / num_freqs) / sample_rate;
+		for (int j = 0; j <= num_delays; ++ j, ++ r) {
+			double d = double(j) / num_delays;
+			double dk = 1.;
+			for (int k = 0; k <= order; ++ k, dk *= d)
+				for (int m = 0; m < taps; ++ m)
+					// Tap m delays by t_m = m - (taps / 2 - 1) samples.
+					a[size_t(r) * n + k * taps + m] = dk * std::polar(1., - w * (m - (taps / 2 - 1)));
+			b[r] = std::polar(1., - w * d);
+		}
+	}
+	// Householder reflections I - 2 v v^H zero the column c below the diagonal, applied to A and b.
+	std::vector<complex> v(rows);
+	for (int c = 0; c < n; ++ c) {
+		double norm = 0.;
+		for (int r = c; r < rows; ++ r)
+			norm += std::norm(a[size_t(r) * n + c]);
+		norm = sqrt(norm);
+		const complex x0 = a[size_t(c) * n + c];
+		const complex alpha = (std::abs(x0) > 0. ? - x0 / std::abs(x0) : complex(-1.)) * norm;
+		double vnorm = 0.;
+		for (int r = c; r < rows; ++ r) {
+			v[r] = a[size_t(r) * n + c] - (r == c ? alpha : complex(0.));
+			vnorm += std::norm(v[r]);
+		}
+		if (vnorm == 0.)
+			continue;
+		vnorm = sqrt(vnorm);
+		for (int r = c; r < rows; ++ r)
+			v[r] /= vnorm;
+		for (int s = c; s < n; ++ s) {
+			complex dot = 0.;
+			for (int r = c; r < rows; ++ r)
+				dot += std::conj(v[r]) * a[size_t(r) * n + s];
+			for (int r = c; r < rows; ++ r)
+				a[size_t(r) * n + s] -= 2. * v[r] * dot;
+		}
+		complex dot = 0.;
+		for (int r = c; r < rows; ++ r)
+			dot += std::conj(v[r]) * b[r];
+		for (int r = c; r < rows; ++ r)
+			b[r] -= 2. * v[r] * dot;
+	}
+	// Back substitution of the upper triangular R x = Q^H b.
+	for (int r = n - 1; r >= 0; -- r) {
+		for (int s = r + 1; s < n; ++ s)
+			b[r] -= a[size_t(r) * n + s] * b[s];
+		b[r] /= a[size_t(r) * n + r];
+	}
+	coef_re.assign(n, 0.);
+	coef_im.assign(n, 0.);
+	for (int r = 0; r < n; ++ r) {
+		coef_re[r] = b[r].real();
+		coef_im[r] = b[r].imag();
+	}
+}
+
+enum DesignKind {
+	DESIGN_CHANNEL_FILTER,
+	DESIGN_FARROW_DELAY,
+};
+
+// Designed filters by their parameters: kind, taps, order, sample rate.
+typedef std::tuple<int, int, int, double> DesignKey;
+static std::mutex s_designs_mutex;
+static std::map<DesignKey, std::unique_ptr<ComplexCoefs>> s_designs;
+
+const ComplexCoefs& channel_filter(int taps, double sample_rate)
+{
+	std::lock_guard<std::mutex> lock(s_designs_mutex);
+	std::unique_ptr<ComplexCoefs> &coefs = s_designs[DesignKey(DESIGN_CHANNEL_FILTER, taps, 0, sample_rate)];
+	if (! coefs) {
+		coefs.reset(new ComplexCoefs);
+		if (taps <= 0 && sample_rate == TABLES_SAMPLE_RATE) {
+			coefs->re.assign(IHilbertBPFirCoef, IHilbertBPFirCoef + HILBPFIR_LENGTH);
+			coefs->im.assign(QHilbertBPFirCoef, QHilbertBPFirCoef + HILBPFIR_LENGTH);
+		} else {
+			if (taps <= 0)
+				// The duration of the built-in filter, odd length for an integer group delay.
+				taps = 2 * int(0.5 * (HILBPFIR_LENGTH - 1) * sample_rate / TABLES_SAMPLE_RATE + 0.5) + 1;
+			taps = std::max(taps, MIN_CHANNEL_FILTER_TAPS);
+			design_hilbert_bandpass(taps, sample_rate, CHANNEL_CENTER_FREQ, CHANNEL_HALF_BANDWIDTH, coefs->re, coefs->im);
+		}
+	}
+	return *coefs;
+}
+
+const ComplexCoefs& channel_farrow_delay(int taps, int order, double sample_rate)
+{
+	std::lock_guard<std::mutex> lock(s_designs_mutex);
+	std::unique_ptr<ComplexCoefs> &coefs = s_designs[DesignKey(DESIGN_FARROW_DELAY, taps, order, sample_rate)];
+	if (! coefs) {
+		coefs.reset(new ComplexCoefs);
+		design_farrow_delay(taps, order, sample_rate,
+			CHANNEL_CENTER_FREQ - CHANNEL_HALF_BANDWIDTH - FD_BAND_MARGIN,
+			CHANNEL_CENTER_FREQ + CHANNEL_HALF_BANDWIDTH + FD_BAND_MARGIN, coefs->re, coefs->im);
+	}
+	return *coefs;
+}
+
+} // namespace PathSim
@@ -0,0 +1,64 @@
+// Windowed sinc FIR filter design, least squares fractional delay design,
+// cached filters of the simulated channel for any sample rate.
+
+#ifndef PATHSIM_FILTER_DESIGN_HPP
+#define PATHSIM_FILTER_DESIGN_HPP
+
+#include <vector>
+
+namespace PathSim {
+
+// Kaiser window shape parameter for the requested stop band attenuation (dB).
+extern double kaiser_beta(double attenuation_db);
+// Transition band width (Hz) of a Kaiser windowed filter of given length and stop band attenuation (dB).
+extern double kaiser_transition_width(int taps, double sample_rate, double attenuation_db);
+// Length of a Kaiser windowed filter for the transition band width (Hz) and stop band attenuation (dB).
+extern int kaiser_taps(double transition_width, double sample_rate, double attenuation_db);
+
+// Kaiser windowed sinc low pass filter with unity DC gain, cutoff in Hz at -6 dB.
+extern std::vector<double> design_lowpass(int taps, double sample_rate, double cutoff, double beta);
+
+// Complex band pass filter centered at center_freq, passing center_freq +- half_bandwidth,
+// split into the real (I, cosine modulated) and imaginary (Q, sine modulated) parts.
+// The scaling follows the built-in Hilbert tables: the I filter alone has unity pass band gain,
+// I + jQ passes the positive frequencies with gain 2, so that the real part of the analytic
+// signal reproduces the input.
+extern void design_hilbert_bandpass(int taps, double sample_rate, double center_freq, double half_bandwidth,
+	std::vector<double> &coef_i, std::vector<double> &coef_q);
+
+// Farrow structure fractional delay filter for a complex signal limited to the band <f_low, f_high>:
+// the signal x delayed by d samples, 0 <= d <= 1, is approximated by
+//     y[n] = sum_{k = 0}^{order} d^k sum_{m = 0}^{taps - 1} c[k * taps + m] x[n + taps / 2 - 1 - m],
+// c = coef_re + j coef_im. The coefficients minimize the squared error of the frequency response
+// over the band and over the fractional delay d (least squares on a grid).
+extern void design_farrow_delay(int taps, int order, double sample_rate, double f_low, double f_high,
+	std::vector<double> &coef_re, std::vector<double> &coef_im);
+
+// Pass band of the simulated channel: 2KHz +- 1.5KHz, the band of the built-in Hilbert tables.
+static constexpr double CHANNEL_CENTER_FREQ     = 2000.;
+static constexpr double CHANNEL_HALF_BANDWIDTH  = 1500.;
+// Sample rate of the built-in Hilbert tables.
+static constexpr double TABLES_SAMPLE_RATE      = 8000.;
+// Shortest designed channel band pass filter, kaiser_transition_width() is not defined for a single tap.
+static constexpr int    MIN_CHANNEL_FILTER_TAPS = 3;
+
+// Complex filter coefficients, real and imaginary parts.
+struct ComplexCoefs
+{
+	std::vector<double> re;
+	std::vector<double> im;
+};
+
+// The filters of the channel are designed once per sample rate and length and shared by all
+// the processors, the returned references stay valid. Thread safe.
+//
+// Channel band pass, the I filter in re, the Q filter in im, see design_hilbert_bandpass().
+// taps == 0: the built-in 59 tap tables at 8 kHz, a filter of the same duration at other sample rates.
+// Shorter filters than MIN_CHANNEL_FILTER_TAPS are extended to it.
+extern const ComplexCoefs& channel_filter(int taps, double sample_rate);
+// Farrow fractional delay coefficients for the channel band, see design_farrow_delay().
+extern const ComplexCoefs& channel_farrow_delay(int taps, int order, double sample_rate);
+
+} // namespace PathSim
+
+#endif // PATHSIM_FILTER_DESIGN_HPP
@@ -20,7 +20,8 @@ static inline double dnorm(double x, double mu, double sigma)
 }
 
 // Calculate length and FIR coefficients for a Gaussian shaped low pass filter.
-void GaussFIR::init(double Fs, double F2sig)
+template<typename T>
+void GaussFIR<T>::init(double Fs, double F2sig)
 {
 	double sigma   = (Fs * SQRT2) / (PI2 * F2sig);
 	m_fir_len = int(0.5 + K_GAUSSIAN * Fs / F2sig);
@@ -28,14 +29,14 @@ void GaussFIR::init(double Fs, double F2sig)
 		// make FIR length odd
 		++ m_fir_len;
 	// Allocate buffer and Coefficient memory based on calculated FIR length.
-    m_coef.assign(m_fir_len * 2, 0.);
-    m_data.assign(m_fir_len, cmplx());
+    m_coef.assign(m_fir_len * 2, T(0));
+    m_data.assign(m_fir_len, cmplx<T>());
 	// generate the scaled Gaussian shaped impulse response	to create a 0 dB
 	//   passband LP filter with a 2 Sigma frequency bandwidth.
 	int index = - (m_fir_len - 1) / 2;
 	double norm = (1.0 / (SQRT2PI * sigma)) / dnorm(0.0, 0.0, sigma);
 	for (int i = 0; i < m_fir_len; ++ i, ++ index) {
-		m_coef[i] = norm * dnorm(index, 0.0, sigma);
+		m_coef[i] = T(norm * dnorm(index, 0.0, sigma));
 		// make duplicate for flat FIR
 		m_coef[i + m_fir_len] = m_coef[i];
 	}
@@ -44,11 +45,12 @@ void GaussFIR::init(double Fs, double F2sig)
 }
 
 // Calculate complex Gaussian FIR filter iteration for one sample.
-cmplx GaussFIR::apply(const cmplx in)
+template<typename T>
+cmplx<T> GaussFIR<T>::apply(const cmplx<T> in)
 {
 	m_data[m_data_ptr] = in;
-	cmplx acc{ 0., 0. };
-    const double *coeff = m_coef.data() + m_fir_len - m_data_ptr;
+	cmplx<T> acc{ 0, 0 };
+    const T *coeff = m_coef.data() + m_fir_len - m_data_ptr;
 	for (int i = 0; i < m_fir_len; ++ i, ++ coeff)
 		// Filter each vector component by a Gaussian kernel.
         acc += m_data[i] * *coeff;
@@ -57,4 +59,7 @@ cmplx GaussFIR::apply(const cmplx in)
 	return acc;
 }
 
+template class GaussFIR<float>;
+template class GaussFIR<double>;
+
 } // namespace PathSim
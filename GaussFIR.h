@@ -9,19 +9,20 @@
 
 namespace PathSim {
 
+template<typename T>
 class GaussFIR
 {
 public:
-	void 	init(double Fs, double F2sig);
-	cmplx 	apply(const cmplx in);
+	void 		init(double Fs, double F2sig);
+	cmplx<T> 	apply(const cmplx<T> in);
 
 private:
 	// Gaussian filter coefficients, repeated so that the filter ptr does not have to roll over.
-	std::vector<double> m_coef;
+	std::vector<T> 		m_coef;
 	// Lenght of the FIR filter
 	int					m_fir_len;
 	// Circular queue of filtered samples.
-	std::vector<cmplx> 	m_data;
+	std::vector<cmplx<T>> m_data;
 	int 				m_data_ptr { 0 };
 };
 
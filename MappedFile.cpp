@@ -0,0 +1,66 @@
+// Read only memory mapping of a file.
+
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace PathSim {
+
+bool MappedFile::open(const std::string &path)
+{
+	this->close();
+#ifdef _WIN32
+	(void)path;
+	return false;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file referenced.
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+	madvise(data, size_t(st.st_size), MADV_SEQUENTIAL);
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = size_t(st.st_size);
+	return true;
+#endif
+}
+
+void MappedFile::release(size_t offset)
+{
+#ifndef _WIN32
+	static const size_t page = size_t(sysconf(_SC_PAGESIZE));
+	const size_t end = std::min(offset, m_size) / page * page;
+	if (m_data != nullptr && end > m_released) {
+		madvise(const_cast<uint8_t*>(m_data) + m_released, end - m_released, MADV_DONTNEED);
+		m_released = end;
+	}
+#else
+	(void)offset;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+	if (m_data != nullptr)
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+	m_data     = nullptr;
+	m_size     = 0;
+	m_released = 0;
+}
+
+} // namespace PathSim
@@ -0,0 +1,45 @@
+// Read only memory mapping of a file.
+
+#ifndef PATHSIM_MAPPED_FILE_HPP
+#define PATHSIM_MAPPED_FILE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace PathSim {
+
+// Maps the whole file read only, so that its contents are read straight from the page cache without
+// a copy. The pages are advised for sequential access: the kernel reads ahead and may drop the pages
+// behind, and processes mapping the same file share its cached pages.
+// Only on POSIX systems, elsewhere open() fails and the caller reads the file by other means.
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { this->close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false if the file cannot be mapped, an empty file included.
+	bool 			open(const std::string &path);
+	void 			close();
+
+	const uint8_t* 	data() const { return m_data; }
+	size_t 			size() const { return m_size; }
+
+	// Drop the whole pages before offset from the mapping of the process, they stay in the page cache.
+	// Bounds the resident memory of a sequential pass over a huge file. The pages are read in again
+	// if touched.
+	void 			release(size_t offset);
+
+private:
+	const uint8_t  *m_data 		{ nullptr };
+	size_t 			m_size 		{ 0 };
+	// Pages before this offset have been released.
+	size_t 			m_released 	{ 0 };
+};
+
+} // namespace PathSim
+
+#endif // PATHSIM_MAPPED_FILE_HPP
@@ -0,0 +1,86 @@
+// Numerically controlled oscillator for the Doppler frequency offset.
+
+#include "NCO.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace PathSim {
+
+static constexpr double PI2 = 6.283185307179586476925286766559;
+
+template<typename T>
+void NCO<T>::init(double phase_increment)
+{
+	m_phase_inc = phase_increment;
+	m_phase 	= 0.;
+	for (int k = 0; k < LANES; ++ k) {
+		m_lane_r[k] = cos(k * phase_increment);
+		m_lane_i[k] = sin(k * phase_increment);
+	}
+	m_step.set(T(cos(LANES * phase_increment)), T(sin(LANES * phase_increment)));
+}
+
+template<typename T>
+void NCO<T>::add_mixed_real(cmplx_block<const T> a, cmplx_block<const T> b, T *out, int n)
+{
+	// Restart the rotators from the exact phase.
+	T pr[LANES], pi[LANES];
+	{
+		double c = cos(m_phase);
+		double s = sin(m_phase);
+		for (int k = 0; k < LANES; ++ k) {
+			pr[k] = T(c * m_lane_r[k] - s * m_lane_i[k]);
+			pi[k] = T(c * m_lane_i[k] + s * m_lane_r[k]);
+		}
+	}
+	const T sr = m_step.r;
+	const T si = m_step.i;
+	// Phasors of one renormalization interval. The rotator recursion is kept out of the mixing loop,
+	// which then has no loop carried dependency and vectorizes.
+	T cr[RENORM_INTERVAL];
+	T ci[RENORM_INTERVAL];
+	for (int i = 0; i < n; i += RENORM_INTERVAL) {
+		const int len = std::min(RENORM_INTERVAL, n - i);
+		int j = 0;
+		for (; j + LANES <= len; j += LANES)
+			for (int k = 0; k < LANES; ++ k) {
+				cr[j + k] = pr[k];
+				ci[j + k] = pi[k];
+				T tr = pr[k] * sr - pi[k] * si;
+				pi[k] = pr[k] * si + pi[k] * sr;
+				pr[k] = tr;
+			}
+		// Tail shorter than LANES.
+		for (int k = 0; j < len; ++ j, ++ k) {
+			cr[j] = pr[k];
+			ci[j] = pi[k];
+		}
+		// Pull the rotators back to the unit circle, first order Newton step of 1 / sqrt(|p|^2).
+		for (int k = 0; k < LANES; ++ k) {
+			T g = T(0.5) * (T(3) - (pr[k] * pr[k] + pi[k] * pi[k]));
+			pr[k] *= g;
+			pi[k] *= g;
+		}
+		// Rotate b first, then only the real part of the product with a is needed.
+		const T *ar = a.r + i;
+		const T *ai = a.i + i;
+		const T *br = b.r + i;
+		const T *bi = b.i + i;
+		T 		*o 	= out + i;
+		for (j = 0; j < len; ++ j) {
+			T gr = br[j] * cr[j] - bi[j] * ci[j];
+			T gi = br[j] * ci[j] + bi[j] * cr[j];
+			o[j] += ar[j] * gr - ai[j] * gi;
+		}
+	}
+	// keep radian counter bounded
+	m_phase = fmod(m_phase + double(n) * m_phase_inc, PI2);
+	if (m_phase < 0.)
+		m_phase += PI2;
+}
+
+template class NCO<float>;
+template class NCO<double>;
+
+} // namespace PathSim
@@ -0,0 +1,49 @@
+// Numerically controlled oscillator for the Doppler frequency offset.
+
+#ifndef PATHSIM_NCO_HPP
+#define PATHSIM_NCO_HPP
+
+#include "cmplx.h"
+
+namespace PathSim {
+
+// Generates exp(j * phase) by a recursive complex rotator instead of calling cos / sin per sample.
+// LANES rotators run interleaved, each one advanced by LANES phase increments per step,
+// so that there is no dependency between neighbor samples. The phasors are generated
+// for RENORM_INTERVAL samples at a time and then applied by a plain vectorized loop.
+// The rotator amplitude is renormalized every RENORM_INTERVAL samples and the rotators
+// are restarted from an exactly accumulated phase at the start of each block,
+// so the phase error does not grow with the length of the run.
+// The phase is accumulated in double precision for both sample types.
+template<typename T>
+class NCO
+{
+public:
+	static constexpr int LANES 			 = 4;
+	static constexpr int RENORM_INTERVAL = 256;
+
+	// Phase increment in radians per sample.
+	void 	init(double phase_increment);
+	// Zero frequency NCO is an identity, the caller may skip it.
+	bool 	active() const { return m_phase_inc != 0.; }
+	// Phase of the next output sample, radians in <0, 2pi).
+	double 	phase() const { return m_phase; }
+
+	// out[i] += Re{ a[i] * b[i] * exp(j * (phase + i * phase_increment)) }, then advance the phase by n samples.
+	// Neither the complex product nor its imaginary part is stored.
+	void 	add_mixed_real(cmplx_block<const T> a, cmplx_block<const T> b, T *out, int n);
+
+private:
+	double 	m_phase_inc 	{ 0. };
+	// Phase at the start of the next block.
+	double 	m_phase 		{ 0. };
+	// exp(j * k * phase_increment) for the k-th lane.
+	double 	m_lane_r[LANES];
+	double 	m_lane_i[LANES];
+	// exp(j * LANES * phase_increment), advances all lanes by one step.
+	cmplx<T> m_step;
+};
+
+} // namespace PathSim
+
+#endif // PATHSIM_NCO_HPP
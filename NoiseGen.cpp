@@ -1,65 +1,99 @@
 #include "NoiseGen.h"
+#include "FilterDesign.h"
+#include "FilterTables.h"
+#include "Simd.h"
 
 #include <math.h>
 #include <string.h>
 
-#ifdef WIN32
-#include <stdlib.h>
-#endif // WIN32
-
-#include "cmplx.h"
-
 namespace PathSim {
 
 // Obtained experimentally to compensate for BP filter.
 static constexpr double K_ENBW = 1.10;
 
-void NoiseGen::init(bool band_limited)
+template<typename T>
+void NoiseGen<T>::init(bool band_limited, double sample_rate, int blocksize, uint64_t seed, uint64_t stream)
 {
 	m_band_limited = band_limited;
-	memset(m_queue, 0, sizeof(m_queue));
-	m_queue_pos = HILBPFIR_LENGTH - 1;
+	m_random.init(seed, stream);
+	// The band pass of the channel (the I filter of the Hilbert pair) at the sample rate.
+	const std::vector<double> &coef = channel_filter(0, sample_rate).re;
+	m_coef.assign(coef.rbegin(), coef.rend());
+	m_history = int(coef.size()) - 1;
+	// Unit white noise has the power spectral density 1 / sample rate, thus the band limited noise
+	// has the power of the sum of squares of the filter. Normalize to the built-in 8kHz filter,
+	// for which K_ENBW was measured, so that the in band noise level holds at any sample rate.
+	double power = 0.;
+	double power_8k = 0.;
+	for (double c : coef)
+		power += c * c;
+	for (int i = 0; i < HILBPFIR_LENGTH; ++ i)
+		power_8k += IHilbertBPFirCoef[i] * IHilbertBPFirCoef[i];
+	m_level_gain = band_limited ? K_ENBW * sqrt(power_8k / power) : K_ENBW;
+	m_fft_filter = band_limited && m_history + 1 >= Hilbert<T>::FFT_MIN_TAPS;
+	if (m_fft_filter) {
+		m_filter.init(0, sample_rate, blocksize);
+		m_noise.assign(blocksize, T(0));
+		m_filtered_q.assign(blocksize, T(0));
+		m_fir_noise.assign(m_history, T(0));
+	} else {
+		m_noise.assign(m_history, T(0));
+		m_filtered_q.clear();
+		m_fir_noise.clear();
+	}
+	m_filtered.assign(blocksize, T(0));
 }
 
 // Adds bufsize gaussian random doubles with 0 mean and
 // RMSlevel = RMS = std to the specified buffer, pInOut
-void NoiseGen::add_band_limited_noise(int bufsize, double *pInOut, double siggain, double RMSlevel)
+//   The noise is processed as a block pipeline: a block of unit white noise is generated,
+//   band limited by the vectorized block FIR, then scaled and added to the scaled signal
+//   in a single pass. The FIR is linear, thus the RMS level is applied after filtering.
+template<typename T>
+void NoiseGen<T>::add_band_limited_noise(int bufsize, T *pInOut, double siggain, double RMSlevel)
 {
-	RMSlevel *= K_ENBW;	// ENBW gain compensation(measured experimentally)
-	for (int i = 0; i < bufsize; ) {
-		// Generate two normally distributed samples as real and imaginatory components
-		// of a normal complex distribution.
-		double noise[2];
-		{
-			double r2;
-			cmplx v;
-			do {
-	            auto rsample = [](){ return 1. - 2. * double(rand())/double(RAND_MAX); };
-	            v.set(rsample(), rsample());
-				r2 = v.l2();
-			} while (r2 >= 1. || r2 == 0.);
-			v *= RMSlevel * sqrt(-2. * log(r2) / r2);
-			noise[0] = v.r;
-			noise[1] = v.i;
-		}
+	if (int(m_filtered.size()) < bufsize)
+		m_filtered.assign(bufsize, T(0));
+	this->generate_block(bufsize, m_filtered.data());
+	this->add_noise(bufsize, m_filtered.data(), pInOut, siggain, RMSlevel);
+}
 
-		for (int j = 0; j < 2; ++ j) {
-			double acc = 0.;
-			if (m_band_limited) {
-				// 3KHz BP filter the Gaussian noise(use one of the Hilbert 3Khz coefficient tables)
-				m_queue[m_queue_pos] = noise[j];
-				const double* Firptr = m_queue;
-				const double* Kptr = IHilbertBPFirCoef+HILBPFIR_LENGTH-m_queue_pos;
-				for (int k = 0; k < HILBPFIR_LENGTH; ++ k)
-					acc += (*Firptr++) * (*Kptr++);
-				if (-- m_queue_pos < 0)
-					m_queue_pos = HILBPFIR_LENGTH - 1;
-			} else
-				acc = noise[j];
-			//  Add BP filtered noise to signal
-			pInOut[i] = siggain * pInOut[i ++] + acc;
-		}
+template<typename T>
+void NoiseGen<T>::generate_block(int bufsize, T *noise)
+{
+	if (m_fft_filter && bufsize == int(m_noise.size())) {
+		m_random.normal_block(m_noise.data(), bufsize);
+		m_filter.filter_block(m_noise.data(), { noise, m_filtered_q.data() });
+		return;
 	}
+	if (! m_band_limited) {
+		m_random.normal_block(noise, bufsize);
+		return;
+	}
+	// The FFT filter takes the blocks of its block size only. The other blocks are filtered in the time domain,
+	// starting from an empty history, with a transient of the filter length at the switch.
+	std::vector<T> &white = m_fft_filter ? m_fir_noise : m_noise;
+	if (int(white.size()) < m_history + bufsize)
+		white.resize(m_history + bufsize, T(0));
+	// Generate the block of normally distributed samples after the filter history.
+	m_random.normal_block(white.data() + m_history, bufsize);
+	// 3KHz BP filter the Gaussian noise(use one of the Hilbert 3Khz coefficient tables)
+	fir_block(white.data(), m_coef.data(), int(m_coef.size()), noise, bufsize);
+	memmove(white.data(), white.data() + bufsize, m_history * sizeof(T));
 }
 
+template<typename T>
+void NoiseGen<T>::add_noise(int bufsize, const T *noise, T *pInOut, double siggain, double RMSlevel) const
+{
+	RMSlevel *= m_level_gain;	// ENBW gain compensation(measured experimentally)
+	//  Add BP filtered noise to signal
+	const T gs = T(siggain);
+	const T gn = T(RMSlevel);
+	for (int i = 0; i < bufsize; ++ i)
+		pInOut[i] = gs * pInOut[i] + gn * noise[i];
+}
+
+template class NoiseGen<float>;
+template class NoiseGen<double>;
+
 } // namespace PathSim
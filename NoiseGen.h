@@ -1,20 +1,51 @@
 #ifndef PATHSIM_NOISEGEN_HPP
 #define PATHSIM_NOISEGEN_HPP
 
-#include "FilterTables.h"
+#include <stdint.h>
+#include <vector>
+
+#include "Delay.h"
+#include "Random.h"
 
 namespace PathSim {
 
+template<typename T>
 class NoiseGen  
 {
 public:
-	void init(bool band_limited);
-	void add_band_limited_noise(int bufsize, double* pInOut, double siggain, double RMSlevel);
+	// seed and stream select an independent sequence of the random generator.
+	// Long band pass filters of high sample rates are applied by FFT to blocks of blocksize samples,
+	// blocks of other sizes are filtered in the time domain.
+	void init(bool band_limited, double sample_rate, int blocksize, uint64_t seed, uint64_t stream);
+	void add_band_limited_noise(int bufsize, T* pInOut, double siggain, double RMSlevel);
+	// The same in two steps, so that the noise of a block may be generated ahead of the signal, concurrently:
+	// generate_block() writes bufsize samples of the band limited unit noise to noise,
+	// add_noise() scales the signal by siggain and adds the noise at RMSlevel.
+	void generate_block(int bufsize, T *noise);
+	void add_noise(int bufsize, const T *noise, T *pInOut, double siggain, double RMSlevel) const;
 
 private:
-	double 	m_queue[HILBPFIR_LENGTH];
-	int 	m_queue_pos;
 	bool    m_band_limited;
+	// Band pass filter coefficients in reversed order for the block FIR kernel.
+	std::vector<T> m_coef;
+	// Long filters: the I output of the Hilbert filter pair by FFT is the band pass filtered noise,
+	// m_filtered_q receives the unused Q output.
+	bool 	m_fft_filter { false };
+	Hilbert<T> m_filter;
+	std::vector<T> m_filtered_q;
+	// Gain making the RMS of the band limited noise independent of the sample rate.
+	double 	m_level_gain;
+
+	// Filter history, number of filter taps - 1.
+	int 	m_history;
+	Random 	m_random;
+	// Unit white noise: m_history samples of the previous block followed by the current block.
+	// The input block of the FFT filter if m_fft_filter.
+	std::vector<T> m_noise;
+	// The same as m_noise for the blocks the FFT filter does not take.
+	std::vector<T> m_fir_noise;
+	// Band limited noise of the current block of add_band_limited_noise().
+	std::vector<T> m_filtered;
 };
 
 } // namespace PathSim
@@ -1,16 +1,19 @@
 #include "Path.h"
 
 #include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
 
-static constexpr const double OFFSET_FREQ_CONST = 2. * M_PI / 8000.;
 static constexpr const double KGNB = 0.62665707; // equivalent Noise BW of Gaussian shaped filter
 
 namespace PathSim {
 
-void Rayleigh::init(double spread, double gain_coeff)
+template<typename T>
+void Rayleigh<T>::init(double spread, double gain_coeff, double sample_rate, uint64_t seed, uint64_t stream)
 {
     assert(spread >= 0 && spread <= 30.0);
     if (spread < 0.)
@@ -18,29 +21,26 @@ void Rayleigh::init(double spread, double gain_coeff)
     else if (spread > 30.0)
         spread = 30.;
     m_spread = spread;
+    m_random.init(seed, stream);
 
     if (spread < 0.1) {
         // here if spread<.1 so will not use any spread just offset
-        m_sample_rate = SampleRate::Rate_None;
-        m_gain        = gain_coeff;
+        m_stages      = 1;
+        m_gain        = T(gain_coeff);
     } else {
-        double rate;
-        if (spread > 2.0) {
-            m_sample_rate = SampleRate::Rate_320_Hz;
-            rate = 320.0;
-        } else if (spread > 0.4) {
-            m_sample_rate = SampleRate::Rate_64_Hz;
-            rate = 64.;
-        } else if (spread >= 0.1) {
-            m_sample_rate = SampleRate::Rate_12_point_8_Hz;
-            rate = 12.8;
+        double nominal = spread > 2.0 ? 320. : spread > 0.4 ? 64. : 12.8;
+        double rate    = sample_rate;
+        m_stages = 0;
+        while (m_stages < MAX_STAGES && rate / INTP_VALUE >= nominal * (1. - 1e-9)) {
+            rate /= INTP_VALUE;
+            ++ m_stages;
         }
         m_lpfir.init(rate, spread);
-        m_gain = gain_coeff * sqrt(rate / (4.0 * spread * KGNB));
+        m_gain = T(gain_coeff * sqrt(rate / (4.0 * spread * KGNB)));
 
         // preload m_lpfir
-        for (int i = 0; i < 250; ++ i)
-            this->sample();
+        std::vector<T> preload_r(250), preload_i(250);
+        this->sample_block({ preload_r.data(), preload_i.data() }, int(preload_r.size()));
     }
 }
 
@@ -48,109 +48,156 @@ void Rayleigh::init(double spread, double gain_coeff)
 // creating two Gaussian random distributed numbers for the I and Q
 // terms and then passing them through a Gaussian shaped low pass FIR filter.
 // The 2 Sigma bandwidth of the LP filter determines the amount of spread.
-cmplx Rayleigh::sample()
+// The Gaussian numbers for the whole block are generated at once.
+template<typename T>
+void Rayleigh<T>::sample_block(cmplx_block<T> out, int n)
 {
-    cmplx out;
     if (m_spread >= 0.1) {
-        // Generate two uniform random numbers between -1 and +1 that are inside the unit circle.
-        cmplx  v;
-        double r2;
-        do {
-            // Generate vector inside a (-1, 1) x (-1, 1) 
-            auto rsample = [](){ return 1. - 2. * double(rand())/double(RAND_MAX); };
-            v.set(rsample(), rsample());
-            r2 = v.l2();
-            // Reject samples outside of the circle.
-        } while (r2 >= 1. || r2 == 0.);
-        // Convert the uniformly sampled unit radius circle distribution into
-        // a complex normal distribution, then low pass filter with a Gaussian shaped FIR filter.
-        // r2 has a uniform distribution in (0, 1)
-        // and v / sqrt(r2) is a unit vector,
-        // thus sqrt(- 2. * log(r2)) has a Rayleigh distribution
-        // and v * sqrt(- 2. * log(r2) / r2) has a complex normal distribution.
-        out = m_lpfir.apply(v * (m_gain * sqrt(- 2. * log(r2) / r2)));
+        if (int(m_normals.size()) < 2 * n)
+            m_normals.assign(2 * n, T(0));
+        m_random.normal_block(m_normals.data(), 2 * n);
+        for (int i = 0; i < n; ++ i) {
+            cmplx<T> s = m_lpfir.apply(cmplx<T>{ m_normals[2 * i], m_normals[2 * i + 1] } * m_gain);
+            out.r[i] = s.r;
+            out.i[i] = s.i;
+        }
     } else
         // Not using any spread.
-        out.set(m_gain, 0);
+        for (int i = 0; i < n; ++ i) {
+            out.r[i] = m_gain;
+            out.i[i] = T(0);
+        }
 
     //gDebug1 = CalcCpxRMS( out, 288000);
     //CalcCpxSweepRMS( out, 500);
-    return out;
 }
 
-void Path::Upsampler::init(int rate)
+// Polyphase branches of the X5 interpolation filter: row p holds the coefficients
+// applied to the upsampler queue slots 0 .. INTP_QUE_SIZE - 1 when its pointer is at p,
+// so that each output sample is a dot product of two contiguous vectors.
+template<typename T>
+struct PolyphaseBranches {
+    PolyphaseBranches() {
+        for (int p = 0; p < INTP_FIR_SIZE; ++ p)
+            for (int j = 0; j < INTP_QUE_SIZE; ++ j)
+                coef[p][j] = T(X5IntrpFIRCoef[INTP_FIR_SIZE - p + INTP_VALUE * j]);
+    }
+    T coef[INTP_FIR_SIZE][INTP_QUE_SIZE];
+};
+template<typename T>
+static const PolyphaseBranches<T> s_polyphase;
+
+template<typename T>
+void Path<T>::Upsampler::init()
 {
     memset(m_queue, 0, sizeof(m_queue));
-    m_ptr = INTP_QUE_SIZE - 1;
-    m_rate = rate;
+    // The first sample goes to the slot of the section of branch INTP_QUE_SIZE - 1,
+    // where the polyphase pointer of the original implementation started.
+    m_slot = (INTP_QUE_SIZE - 1) / INTP_VALUE + 1;
+    m_left = 0;
 }
 
-void Path::Upsampler::insert_sample(cmplx v)
+template<typename T>
+int Path<T>::Upsampler::inputs_needed(int n) const
 {
-    m_queue[m_ptr / INTP_VALUE] = v;
+    // The first m_left outputs finish the current run, each further INTP_VALUE outputs take a new sample.
+    return m_left < n ? (n - m_left + INTP_VALUE - 1) / INTP_VALUE : 0;
 }
 
-cmplx Path::Upsampler::upsample()
+template<typename T>
+void Path<T>::Upsampler::upsample_block(cmplx_block<const T> in, cmplx_block<T> out, int n)
 {
-    const cmplx*    firptr = m_queue;
-    const double*   kptr   = X5IntrpFIRCoef + INTP_FIR_SIZE - m_ptr;
-    cmplx           acc{ 0., 0. };
-    for (int j = 0; j < INTP_QUE_SIZE; ++ j, kptr += INTP_VALUE, ++ firptr)
-        acc += (*firptr) * (*kptr);
-    if (-- m_ptr < 0)
-        m_ptr = INTP_FIR_SIZE - 1;
-    return acc;
+    // The run left over from the previous block first, then a run per sample inserted.
+    for (int i = 0, k = 0; i < n;) {
+        if (m_left == 0) {
+            if (-- m_slot < 0)
+                m_slot = INTP_QUE_SIZE - 1;
+            m_queue[m_slot].set(in.r[k], in.i[k]);
+            ++ k;
+            m_left = INTP_VALUE;
+        }
+        const int run = std::min(m_left, n - i);
+        // The branches of a run are consecutive rows, in descending order.
+        const T *coef = s_polyphase<T>.coef[m_slot * INTP_VALUE + m_left - 1];
+        for (int end = i + run; i < end; ++ i, coef -= INTP_QUE_SIZE) {
+            cmplx<T> acc{ 0, 0 };
+            for (int j = 0; j < INTP_QUE_SIZE; ++ j)
+                acc += m_queue[j] * coef[j];
+            out.r[i] = acc.r;
+            out.i[i] = acc.i;
+        }
+        m_left -= run;
+    }
 }
 
-void Path::init_path(double spread, double offset, int blocksize, int numpaths)
+template<typename T>
+void Path<T>::init_path(double spread, double offset, double sample_rate, int blocksize, int numpaths, uint64_t seed, uint64_t stream)
 {
     m_block_size        = blocksize;
-    m_offset_frequency  = offset;
-    m_index             = 0;
-    m_phase_acc         = 0.;
-
-    int rate = INTP_VALUE;
-    for (int i = 0; i < 4; ++ i, rate *= INTP_VALUE)
-       m_upsamplers[i].init(rate);
-
-    m_rayleigh.init(spread, 1. / sqrt(double(numpaths)));
+    m_nco.init(2. * M_PI / sample_rate * offset);
+
+    for (Upsampler &upsampler : m_upsamplers)
+       upsampler.init();
+    // Each stage needs at most one sample more than 1/INTP_VALUE of the samples of the stage below.
+    std::vector<int> lens;
+    for (int i = 0, len = blocksize; i <= NUM_STAGES; ++ i, len = len / INTP_VALUE + 1)
+        lens.emplace_back(len);
+    m_stage_arena.init(lens);
+    for (int i = 0; i <= NUM_STAGES; ++ i)
+        m_stage[i] = m_stage_arena.block(i);
+
+    m_rayleigh.init(spread, 1. / sqrt(double(numpaths)), sample_rate, seed, stream);
 }
 
-// Performs a path calculation on pIn and puts it in pOut
+// Performs a path calculation on the input block and adds the real part of the result to pOut
 //
 //  Two Low Pass filtered Gaussian random numbers are created at
-//	12.8, 64 Hz, or 320 Hz rate.  These form the input to a complex
-//	interpolation filter that bumps the sample rate up to 8000Hz.
+//	12.8, 64 Hz, or 320 Hz rate (at 8kHz).  These form the input to a complex
+//	interpolation filter that bumps the sample rate up to the output sample rate.
 //
-//	Two, three, or four stages of X5 upsampling/interpolation are used.
+//	Two, three, or four stages of X5 upsampling/interpolation are used at 8kHz,
+//	more at higher sample rates, see Rayleigh::init().
 //	The complex noise is then multiplied by the input I/Q signal
 //	to produce the spreading/fading simulation.
 //
 //  Finally a complex NCO is multiplied by the signal to produce a
 //	Frequency offset.
-void Path::calc_path(const cmplx *pIn, cmplx *pOut)
+//
+//  The fading, the NCO and the summation of the paths are fused into a single pass:
+//  the output is real, so only Re{in * fading * nco} is calculated and accumulated,
+//  the complex path output is never stored.
+//
+//  The cascade is evaluated stage by stage for the whole block: first the number of samples
+//  each stage consumes is calculated from the output stage up, then the Rayleigh samples are
+//  generated and upsampled by each stage in turn.
+template<typename T>
+void Path<T>::add_path(cmplx_block<const T> in, T *pOut)
 {
-    for (int i = 0; i < m_block_size; ++ i) {
-        {
-            int j = int(m_rayleigh.sample_rate());
-            if (m_upsamplers[j].insert_at(m_index))
-                m_upsamplers[j].insert_sample(m_rayleigh.sample());
-            for (-- j; j >= 0; -- j)
-                if (m_upsamplers[j].insert_at(m_index))
-                    m_upsamplers[j].insert_sample(m_upsamplers[j + 1].upsample());
-        }
-        cmplx fading = m_upsamplers[0].upsample();
-//CalcCpxSweepRMS( fading, 8000);
-        pOut[i] =
-            // Doppler
-            cmplx{cos(m_phase_acc), sin(m_phase_acc)} *
-            // Fading
-            (fading * pIn[i]);
-        // keep radian counter bounded
-        m_phase_acc = fmod(m_phase_acc + OFFSET_FREQ_CONST * m_offset_frequency, 2. * M_PI);
-        if (++ m_index >= INTP_VALUE*INTP_VALUE*INTP_VALUE*INTP_VALUE*m_block_size)
-            m_index = 0;
+    const int top = m_rayleigh.stages() - 1;
+    int len[NUM_STAGES + 1];
+    len[0] = m_block_size;
+    for (int j = 0; j <= top; ++ j)
+        len[j + 1] = m_upsamplers[j].inputs_needed(len[j]);
+    m_rayleigh.sample_block(m_stage[top + 1], len[top + 1]);
+    for (int j = top; j >= 0; -- j)
+        m_upsamplers[j].upsample_block(m_stage[j + 1], m_stage[j], len[j]);
+
+    if (m_nco.active())
+        // Fading and Doppler.
+        m_nco.add_mixed_real(in, m_stage[0], pOut, m_block_size);
+    else {
+        // Fading only, the NCO is skipped for paths without frequency offset.
+        const T *fr = m_stage[0].r;
+        const T *fi = m_stage[0].i;
+        for (int i = 0; i < m_block_size; ++ i)
+//CalcCpxSweepRMS( fading[i], 8000);
+            pOut[i] += in.r[i] * fr[i] - in.i[i] * fi[i];
     }
 }
 
+template class Rayleigh<float>;
+template class Rayleigh<double>;
+template class Path<float>;
+template class Path<double>;
+
 } // namespace PathSim
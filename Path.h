@@ -2,72 +2,92 @@
 #define PATHSIM_PATH_HPP
 
 #include <math.h>
+#include <vector>
 
+#include "Arena.h"
 #include "cmplx.h"
 #include "FilterTables.h"
 #include "GaussFIR.h"
+#include "NCO.h"
+#include "Random.h"
 
 namespace PathSim {
 
 // Rayleigh distribution
+template<typename T>
 class Rayleigh {
 public:
-	enum class SampleRate {
-		// Indices correspond to Path::m_upsamplers!
-	    Rate_12_point_8_Hz = 3, // Used for 0.1 > Spread >= 0.4
-	    Rate_64_Hz = 2,			// Used for 0.4 > Spread >= 2.0
-	    Rate_320_Hz = 1,       	// Used for 2.0 > Spread >= 10.0
-	    Rate_None = 0, 			// Used for super low Spread < 0.1
-	};
-
-	void  		init(double spread, double gain_coeff);
-	cmplx 		sample();
-	SampleRate  sample_rate() const { return m_sample_rate; }
+	// Maximum number of X5 upsampling stages from the fading rate to the output sample rate.
+	static constexpr int MAX_STAGES = 6;
+
+	// The fading is sampled at the output sample rate divided by a power of 5, so that
+	// it is upsampled to the output rate by X5 stages. The lowest such rate is chosen that is
+	// not below the nominal rate for the spread: 320 Hz for spread > 2.0, 64 Hz for spread > 0.4,
+	// 12.8 Hz for spread >= 0.1, which are exactly 2, 3 and 4 stages at 8 kHz. For super low
+	// spread < 0.1 the fading is constant and goes through a single stage.
+	// seed and stream select an independent sequence of the random generator.
+	void  		init(double spread, double gain_coeff, double sample_rate, uint64_t seed, uint64_t stream);
+	// Generate n samples of the fading process.
+	void 		sample_block(cmplx_block<T> out, int n);
+	// Number of X5 upsampling stages to the output sample rate.
+	int 		stages() const { return m_stages; }
 
 private:
 	double 	 	m_spread;
-	double 	 	m_gain;
-	SampleRate 	m_sample_rate { SampleRate::Rate_12_point_8_Hz };
+	T 	 		m_gain;
+	int 		m_stages { 1 };
 
 	// Gaussian FIR low pass filter
-	GaussFIR 	m_lpfir;
+	GaussFIR<T>	m_lpfir;
+	// Source of the Gaussian noise, I and Q interleaved.
+	Random 		m_random;
+	std::vector<T> m_normals;
 };
 
+template<typename T>
 class Path
 {
 public:
 	Path() {}
 
-	void init_path(double spread, double offset, int blocksize, int numpaths);
-	void calc_path(const cmplx* pIn, cmplx* pOut);
+	void init_path(double spread, double offset, double sample_rate, int blocksize, int numpaths, uint64_t seed, uint64_t stream);
+	// Apply the fading and the Doppler offset to the input block and add the real part of the result to out.
+	void add_path(cmplx_block<const T> in, T *out);
 
 private:
-	// Polyphase upsampling low pass FIR filter.
+	// Polyphase X5 upsampling low pass FIR filter.
 	class Upsampler
 	{
 	public:
-		void  init(int rate);
-		void  insert_sample(cmplx v);
-		cmplx upsample();
-
-		int   insert_at(int index) const { return index % m_rate == 0; }
+		void  init();
+		// Number of input samples consumed by the next n output samples.
+		int   inputs_needed(int n) const;
+		// Produce n output samples, consuming inputs_needed(n) samples of pIn.
+		void  upsample_block(cmplx_block<const T> in, cmplx_block<T> out, int n);
 
 	private:
 		// Samples to be upsampled and low pass filtered by a polyphase filter.
-		cmplx m_queue[INTP_QUE_SIZE];
-		// Pointer has a span of INTP_VALUE x INTP_QUE_SIZE.
-		int   m_ptr;
-		// Upsampling rate
-		int   m_rate;
+		// Kept interleaved: the dot product over the queue runs on both components in one vector.
+		cmplx<T> m_queue[INTP_QUE_SIZE];
+		// Each sample inserted starts a run of INTP_VALUE output samples, one per polyphase branch
+		// of its INTP_VALUE section: m_slot is the queue slot of the last sample inserted,
+		// m_left the number of the output samples left of its run.
+		int   m_slot;
+		int   m_left;
 	};
 
-	int 		m_block_size;
-	int 		m_index { 0 };
-	double 		m_offset_frequency;
-	double 		m_phase_acc;
+	static constexpr int NUM_STAGES = Rayleigh<T>::MAX_STAGES;
 
-	Rayleigh 	m_rayleigh;
-	Upsampler 	m_upsamplers[4];
+	int 		m_block_size;
+	// Doppler frequency offset oscillator.
+	NCO<T> 		m_nco;
+
+	Rayleigh<T>	m_rayleigh;
+	Upsampler 	m_upsamplers[NUM_STAGES];
+	// Output of each upsampler stage for the current block, m_stage[0] is the fading at the output sample rate,
+	// m_stage[j + 1] is the input of m_upsamplers[j]. Views into m_stage_arena.
+	Arena<T> 	m_stage_arena;
+	cmplx_block<T> m_stage[NUM_STAGES + 1];
 };
 
 } // namespace PathSim
@@ -1,6 +1,7 @@
 #ifndef PATHSIM_PARAMS_HPP
 #define PATHSIM_PARAMS_HPP
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -8,12 +9,14 @@ namespace PathSim {
 
 struct PathParams
 {
-	// Delay of the path in ms, 0 to 30ms.
+	// Delay of the path in ms, 0 to 30ms. Fractions of the sample period are interpolated.
 	double  delay       { 0. };
 	// Raileigh spread
 	double	spread	 	{ 0. };
 	// Frequency offset in Hz
 	double	offset 		{ 0. };
+	// Drift of the delay in ms per second, positive for a growing delay.
+	double  delay_rate  { 0. };
 };
 
 struct NoiseParams
@@ -33,6 +36,17 @@ struct PathSimParams
 
     std::vector<PathParams> paths;
     NoiseParams             noise;
+
+    // Length of the input band pass / Hilbert filter, 0 for the built-in 59 tap filter.
+    int                     filter_taps { 0 };
+    // Seed of the random generators of the fading and of the noise.
+    uint64_t                seed        { 0 };
+    // Samples processed at a time, 0 for the default PathSimProcessor::BUF_SIZE.
+    // Smaller blocks lower the latency of the streaming interface at some cost of throughput.
+    int                     block_size  { 0 };
+    // Threads evaluating the paths and generating the noise of the next block concurrently, 0 or 1 for none.
+    // The output does not depend on the number of threads.
+    int                     threads     { 0 };
 };
 
 extern const std::vector<PathSimParams>& default_params();
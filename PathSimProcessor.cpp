@@ -1,5 +1,9 @@
 #include "PathSimProcessor.h"
 
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
 namespace PathSim {
 
 // RMS amplitude out of 32768
@@ -7,89 +11,341 @@ namespace PathSim {
 // plus signals will not overflow soundcard
 static constexpr double RMS_MAXAMPLITUDE = 0.122; // 4000. / 32768.;
 
+// Number of BUF_SIZE blocks at RMSAVE_SAMPLE_RATE the input RMS is averaged over.
 static constexpr double RMSAVE = 20.;
+static constexpr double RMSAVE_SAMPLE_RATE = 8000.;
+
+// Random generator streams: the noise generator and the paths draw independent sequences of the same seed.
+static constexpr uint64_t NOISE_STREAM      = 0;
+static constexpr uint64_t FIRST_PATH_STREAM = 1;
+
+// Resamplers of ResamplingProcessor: pass band up to 3.6 kHz, above the 3.5 kHz edge of the channel,
+// stop band from 4.4 kHz. At 8 kHz the aliases of the transition band fold above 3.6 kHz.
+static constexpr double RESAMPLER_PASSBAND      = 3600.;
+static constexpr double RESAMPLER_STOPBAND      = 4400.;
+static constexpr double RESAMPLER_ATTENUATION   = 80.;
 
-PathSimProcessor::~PathSimProcessor()
+template<typename T>
+PathSimProcessor<T>::~PathSimProcessor()
 {
 #ifdef PATHSIM_TESTMODE
     EndTest();
 #endif
 }
 
-void PathSimProcessor::init(const PathSimParams& params)
+template<typename T>
+void PathSimProcessor<T>::init(const PathSimParams& params, double sample_rate)
 {
     m_params = params;
+    assert(sample_rate >= MIN_SAMPLE_RATE && sample_rate <= MAX_SAMPLE_RATE);
+    m_sample_rate = std::max(MIN_SAMPLE_RATE, std::min(MAX_SAMPLE_RATE, sample_rate));
 
     int numpaths = int(m_params.paths.size());
     m_direct_path = numpaths == 0;
 
-    m_paths.assign(numpaths, { {}, {BUF_SIZE, cmplx{}} });
-    m_noise_gen.init(true);
+    m_block_size = params.block_size > 0 ? std::min(int(BUF_SIZE), params.block_size) : BUF_SIZE;
+    // The averaging time is independent of the block size and of the sample rate.
+    m_rms_weight = (double(m_block_size) * RMSAVE_SAMPLE_RATE / (double(BUF_SIZE) * m_sample_rate)) / RMSAVE;
+    m_fifo_in.assign(m_block_size, T(0));
+    m_fifo_out.assign(m_block_size, T(0));
+    m_fifo_fill = 0;
+
+    m_paths.assign(numpaths, {});
+    m_noise_gen.init(true, m_sample_rate, m_block_size, params.seed, NOISE_STREAM);
 
     if (! m_direct_path) {
-        m_hilbert.init();
-        m_delay.init();
+        m_hilbert.init(params.filter_taps, m_sample_rate, m_block_size);
+        m_delay.init(m_sample_rate, m_block_size);
         for (const PathParams& p : params.paths) {
             int i = int(&p - params.paths.data());
-            m_paths[i].path.init_path(p.spread, p.offset, BUF_SIZE, numpaths);
-            if (i > 0)
-                m_delay.add_delay(p.delay);
+            m_paths[i].init_path(p.spread, p.offset, m_sample_rate, m_block_size, numpaths, params.seed, FIRST_PATH_STREAM + i);
+            // The first path is the reference, it is not delayed. The i-th path reads the i-th tap.
+            m_delay.add_delay(i == 0 ? 0. : p.delay, i == 0 ? 0. : p.delay_rate);
         }
     }
 
+    // The paths and the noise run on the pool only if there is more than one task.
+    const int ntasks = numpaths + (params.noise.has_awgn ? 1 : 0);
+    m_threaded = params.threads > 1 && ntasks > 1;
+    m_pool.start(m_threaded ? std::min(params.threads, ntasks) : 0);
+    m_path_out.assign(m_threaded ? size_t(numpaths) * m_block_size : 0, T(0));
+    m_noise_block.assign(m_block_size, T(0));
+    m_noise_next.assign(m_threaded ? m_block_size : 0, T(0));
+    m_noise_ready = false;
+
     m_SNR = pow(10., params.noise.snr / 20.0);
     m_SigRMS = RMS_MAXAMPLITUDE;
 }
 
-void PathSimProcessor::process_buffer(double *buffer)
+template<typename T>
+void PathSimProcessor<T>::run_task(void *context, int i)
+{
+    PathSimProcessor<T> &self = *static_cast<PathSimProcessor<T>*>(context);
+    if (i < int(self.m_paths.size())) {
+        T *out = self.m_path_out.data() + size_t(i) * self.m_block_size;
+        std::fill(out, out + self.m_block_size, T(0));
+        self.m_paths[i].add_path(self.m_delay.tap(i), out);
+    } else
+        self.m_noise_gen.generate_block(self.m_block_size, self.m_noise_next.data());
+}
+
+// Gains of the signal and of the noise for the SNR (fraction) at the input RMS sig_rms.
+static void snr_gains(double snr, double sig_rms, double &signal_gain, double &noise_rms)
+{
+    if (snr >= 1.0) {
+        signal_gain = RMS_MAXAMPLITUDE / sig_rms;
+        noise_rms   = signal_gain * sig_rms / snr;
+    } else {
+        signal_gain = RMS_MAXAMPLITUDE * snr / sig_rms;
+        noise_rms   = RMS_MAXAMPLITUDE;
+    }
+}
+
+template<typename T>
+void PathSimProcessor<T>::update_levels(const T *buffer)
 {
     {
         // Calculate sum of squares for RMS calculations
         double acc = 0.;
-        for (int i = 0; i < BUF_SIZE; ++ i)
-            acc += buffer[i] * buffer[i];
+        for (int i = 0; i < m_block_size; ++ i)
+            acc += double(buffer[i]) * double(buffer[i]);
         // Simple IIR LP filter the rms averages
-        m_SigRMS = (1.0 / RMSAVE) * sqrt(acc / BUF_SIZE) + (1.0 - 1.0 / RMSAVE) * m_SigRMS;
+        m_SigRMS = m_rms_weight * sqrt(acc / m_block_size) + (1.0 - m_rms_weight) * m_SigRMS;
     }
-    if (! m_params.noise.has_awgn) {
+    if (m_params.noise.has_awgn)
+        // if AWGN is used, figure out gains for SNR
+        snr_gains(m_SNR, m_SigRMS, m_SignalGain, m_NoiseRMS);
+    else {
         m_SignalGain = 1.0;
         m_NoiseRMS   = 0.0;
     }
-    m_state.m_SigRMS = m_SigRMS;
+    m_state.m_SigRMS   = m_SigRMS;
+    m_state.m_NoiseRMS = m_NoiseRMS;
+}
+
+template<typename T>
+void PathSimProcessor<T>::process_buffer(T *buffer)
+{
+    this->update_levels(buffer);
 
     if (! m_direct_path) {
         // Bandpass filter into I and Q and get delayed versions of the input data
-        static_assert(m_hilbert.BLOCKSIZE == this->BUF_SIZE, "Buffer length has to be satisfied");
-        m_hilbert.filter_block(buffer, m_paths.front().buffer.data());
-        static_assert(m_delay.BLOCKSIZE == this->BUF_SIZE, "Buffer length has to be satisfied");
-        std::vector<std::vector<cmplx>*> buffers;
-        buffers.reserve(m_paths.size() - 1);
-        for (size_t i = 1; i < m_paths.size(); ++ i)
-            buffers.emplace_back(&m_paths[i].buffer);
-        m_delay.delay_block(m_paths.front().buffer, buffers);
-        // Calculate each path.
-        for (PathWithBuffer& path : m_paths)
-            path.path.calc_path(path.buffer.data(), path.buffer.data());
-        // Sum and Copy just the real part back into the real buffer for output
-        for (int i = 0; i < BUF_SIZE; ++ i) {
-            double acc = 0;
-            for (PathWithBuffer& path : m_paths)
-                acc += path.buffer[i].r;
-            buffer[i] = acc;
+        static_assert(Hilbert<T>::BLOCKSIZE >= BUF_SIZE, "Buffer length has to be satisfied");
+        // The analytic signal is written straight into the delay line.
+        static_assert(Delay<T>::BLOCKSIZE >= BUF_SIZE, "Buffer length has to be satisfied");
+        m_hilbert.filter_block(buffer, m_delay.input_block());
+    }
+    this->process_delayed(buffer);
+}
+
+template<typename T>
+void PathSimProcessor<T>::process_buffer_analytic(T *buffer, cmplx_block<const T> analytic)
+{
+    this->update_levels(buffer);
+
+    if (! m_direct_path) {
+        cmplx_block<T> dst = m_delay.input_block();
+        memcpy(dst.r, analytic.r, m_block_size * sizeof(T));
+        memcpy(dst.i, analytic.i, m_block_size * sizeof(T));
+    }
+    this->process_delayed(buffer);
+}
+
+template<typename T>
+void PathSimProcessor<T>::process_delayed(T *buffer)
+{
+    if (! m_direct_path)
+        m_delay.interpolate();
+    if (m_threaded) {
+        // The noise of this block has been generated during the previous one, except for the first block.
+        const bool noise = m_params.noise.has_awgn;
+        if (noise) {
+            if (! m_noise_ready)
+                m_noise_gen.generate_block(m_block_size, m_noise_next.data());
+            m_noise_block.swap(m_noise_next);
+            m_noise_ready = true;
+        }
+        m_pool.run(&PathSimProcessor<T>::run_task, this, int(m_paths.size()) + (noise ? 1 : 0));
+        if (! m_direct_path) {
+            const T *out = m_path_out.data();
+            std::copy(out, out + m_block_size, buffer);
+            for (size_t j = 1; j < m_paths.size(); ++ j) {
+                out += m_block_size;
+                for (int i = 0; i < m_block_size; ++ i)
+                    buffer[i] += out[i];
+            }
         }
+    } else if (! m_direct_path) {
+        // Calculate each path on its delayed view of the delay line
+        // and sum just the real part into the real buffer for output.
+        std::fill(buffer, buffer + m_block_size, T(0));
+        for (size_t j = 0; j < m_paths.size(); ++ j)
+            m_paths[j].add_path(m_delay.tap(int(j)), buffer);
     }
+    if (! m_direct_path)
+        m_delay.advance();
     if (m_params.noise.has_awgn) {
-        // if AWGN is used, figure out gains for SNR
-        if (m_SNR >= 1.0) {
-            m_SignalGain = RMS_MAXAMPLITUDE / m_SigRMS;
-            m_NoiseRMS   = m_SignalGain * m_SigRMS / m_SNR;
-        } else {
-            m_SignalGain = RMS_MAXAMPLITUDE * m_SNR / m_SigRMS;
-            m_NoiseRMS   = RMS_MAXAMPLITUDE;
+        if (m_threaded)
+            m_noise_gen.add_noise(m_block_size, m_noise_block.data(), buffer, m_SignalGain, m_NoiseRMS);
+        else
+            m_noise_gen.add_band_limited_noise(m_block_size, buffer, m_SignalGain, m_NoiseRMS);
+    }
+}
+
+template<typename T>
+void PathSimProcessor<T>::process_buffer_snr_sweep(T *buffer, const double *snr_db, int count, T *const *outputs)
+{
+    assert(! m_params.noise.has_awgn);
+    // The channel without the noise, then a single block of noise added at each SNR.
+    this->process_buffer(buffer);
+    m_noise_gen.generate_block(m_block_size, m_noise_block.data());
+    for (int k = 0; k < count; ++ k) {
+        double signal_gain, noise_rms;
+        snr_gains(pow(10., snr_db[k] / 20.0), m_SigRMS, signal_gain, noise_rms);
+        std::copy(buffer, buffer + m_block_size, outputs[k]);
+        m_noise_gen.add_noise(m_block_size, m_noise_block.data(), outputs[k], signal_gain, noise_rms);
+    }
+}
+
+template<typename T>
+void PathSimProcessor<T>::init_frame(Frame &frame) const
+{
+    frame.samples.assign(m_block_size, T(0));
+    frame.taps.init(int(m_paths.size()), m_block_size);
+}
+
+template<typename T>
+void PathSimProcessor<T>::stage_analyze(Frame &frame)
+{
+    T *buffer = frame.samples.data();
+    this->update_levels(buffer);
+    frame.signal_gain = m_SignalGain;
+    frame.noise_rms   = m_NoiseRMS;
+    if (! m_direct_path) {
+        m_hilbert.filter_block(buffer, m_delay.input_block());
+        m_delay.interpolate();
+        // The taps are views into the delay line, which the next block overwrites.
+        for (int j = 0; j < int(m_paths.size()); ++ j) {
+            cmplx_block<const T> tap = m_delay.tap(j);
+            cmplx_block<T>       dst = frame.taps.block(j);
+            memcpy(dst.r, tap.r, m_block_size * sizeof(T));
+            memcpy(dst.i, tap.i, m_block_size * sizeof(T));
         }
-        m_noise_gen.add_band_limited_noise(BUF_SIZE, buffer, m_SignalGain, m_NoiseRMS);
+        m_delay.advance();
     }
-    m_state.m_NoiseRMS = m_NoiseRMS;
 }
 
+template<typename T>
+void PathSimProcessor<T>::stage_paths(Frame &frame)
+{
+    if (m_direct_path)
+        return;
+    T *buffer = frame.samples.data();
+    std::fill(buffer, buffer + m_block_size, T(0));
+    for (int j = 0; j < int(m_paths.size()); ++ j)
+        m_paths[j].add_path(frame.taps.block(j), buffer);
+}
+
+template<typename T>
+void PathSimProcessor<T>::stage_noise(Frame &frame)
+{
+    if (m_params.noise.has_awgn)
+        m_noise_gen.add_band_limited_noise(m_block_size, frame.samples.data(), frame.signal_gain, frame.noise_rms);
+}
+
+// Each input sample is stored into the input FIFO and the output sample of the same position
+// of the previous block is read from the output FIFO. Once the input FIFO is full, it is processed
+// in place and the FIFOs are swapped.
+template<typename T>
+void PathSimProcessor<T>::process(const T *in, T *out, size_t n)
+{
+    while (n > 0) {
+        const int len = int(std::min<size_t>(n, size_t(m_block_size - m_fifo_fill)));
+        // The input is read before the output is written, in and out may be the same.
+        memcpy(m_fifo_in.data() + m_fifo_fill, in, len * sizeof(T));
+        memcpy(out, m_fifo_out.data() + m_fifo_fill, len * sizeof(T));
+        in  += len;
+        out += len;
+        n   -= size_t(len);
+        m_fifo_fill += len;
+        if (m_fifo_fill == m_block_size) {
+            this->process_buffer(m_fifo_in.data());
+            m_fifo_in.swap(m_fifo_out);
+            m_fifo_fill = 0;
+        }
+    }
+}
+
+template<typename T>
+int PathSimProcessor<T>::latency() const
+{
+    // The direct path bypasses the band pass filter.
+    return m_direct_path ? m_block_size : m_block_size + m_hilbert.group_delay();
+}
+
+template class PathSimProcessor<float>;
+template class PathSimProcessor<double>;
+
+template<typename T>
+void ResamplingProcessor<T>::init(const PathSimParams &params, double sample_rate)
+{
+    const int rate = int(sample_rate + 0.5);
+    assert(double(rate) == sample_rate);
+    m_resample = rate != INTERNAL_SAMPLE_RATE;
+    m_ratio    = double(rate) / double(INTERNAL_SAMPLE_RATE);
+    m_processor.init(params, m_resample ? double(INTERNAL_SAMPLE_RATE) : sample_rate);
+    if (m_resample) {
+        m_down.init(rate, INTERNAL_SAMPLE_RATE, RESAMPLER_PASSBAND, RESAMPLER_STOPBAND, RESAMPLER_ATTENUATION);
+        m_up  .init(INTERNAL_SAMPLE_RATE, rate, RESAMPLER_PASSBAND, RESAMPLER_STOPBAND, RESAMPLER_ATTENUATION);
+        m_low.assign(m_down.max_output(CHUNK), T(0));
+        // A chunk converted up plus the surplus of the previous chunks, less than one low rate sample.
+        m_fifo.assign(m_up.max_output(int(m_low.size())) + int(m_ratio) + 2, T(0));
+    }
+    m_fifo_fill = 0;
+}
+
+// A chunk of input converted down yields ceil(n / ratio) samples in total, converted back up at least n,
+// so the FIFO never runs dry and the output is a constant delay behind the input.
+template<typename T>
+void ResamplingProcessor<T>::process(const T *in, T *out, size_t n)
+{
+    if (! m_resample) {
+        m_processor.process(in, out, n);
+        return;
+    }
+    while (n > 0) {
+        const int len  = int(std::min<size_t>(n, CHUNK));
+        const int nlow = m_down.process(in, len, m_low.data());
+        m_processor.process(m_low.data(), m_low.data(), size_t(nlow));
+        m_fifo_fill += m_up.process(m_low.data(), nlow, m_fifo.data() + m_fifo_fill);
+        assert(m_fifo_fill >= len && m_fifo_fill <= int(m_fifo.size()));
+        // The input chunk has been consumed, in and out may be the same.
+        memcpy(out, m_fifo.data(), len * sizeof(T));
+        m_fifo_fill -= len;
+        memmove(m_fifo.data(), m_fifo.data() + len, m_fifo_fill * sizeof(T));
+        in  += len;
+        out += len;
+        n   -= size_t(len);
+    }
+}
+
+template<typename T>
+int ResamplingProcessor<T>::latency() const
+{
+    if (! m_resample)
+        return m_processor.latency();
+    return int(floor((m_down.group_delay() + m_processor.latency()) * m_ratio + m_up.group_delay() + 0.5));
+}
+
+template<typename T>
+int ResamplingProcessor<T>::resampling_delay() const
+{
+    if (! m_resample)
+        return m_processor.block_size();
+    return int(floor((m_down.group_delay() + m_processor.block_size()) * m_ratio + m_up.group_delay() + 0.5));
+}
+
+template class ResamplingProcessor<float>;
+template class ResamplingProcessor<double>;
+
 } // namespace PathSim
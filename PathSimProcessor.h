@@ -5,24 +5,81 @@
 #include "PathSimParams.h"
 #include "NoiseGen.h"
 #include "Delay.h"
+#include "Resampler.h"
+#include "WorkerPool.h"
 
 #include <math.h>
 #include <utility>
 
 namespace PathSim {
 
+// The whole DSP chain is instantiated for float and for double samples.
+template<typename T>
 class PathSimProcessor
 {
 public:
     ~PathSimProcessor();
 
-    void init(const PathSimParams &params);
+    // The whole chain is designed for the sample rate, MIN_SAMPLE_RATE to MAX_SAMPLE_RATE.
+    void init(const PathSimParams &params, double sample_rate);
 
-	// Size of data chunks to process one at a time.
+    static constexpr double MIN_SAMPLE_RATE = 8000.;
+    static constexpr double MAX_SAMPLE_RATE = 192000.;
+
+	// Default and maximum size of data chunks to process one at a time.
 	static constexpr int BUF_SIZE = 2048;
-    void process_buffer(double *buffer);
+    // Size of the chunks processed by process_buffer(), PathSimParams::block_size or BUF_SIZE.
+    int  block_size() const { return m_block_size; }
+    // Process block_size() samples in place.
+    void process_buffer(T *buffer);
+    // SNR sweep: the block is processed once in place without the noise, then it is written to outputs[k]
+    // with the noise added at snr_db[k] dB, k = 0 .. count - 1. The noise realization is the same at all
+    // the SNRs, outputs[k] is the output of process_buffer() with PathSimParams::noise.snr = snr_db[k]
+    // for the same seed. The processor has to be initialized with PathSimParams::noise.has_awgn false.
+    void process_buffer_snr_sweep(T *buffer, const double *snr_db, int count, T *const *outputs);
+    // Process block_size() samples in place with the output of the band pass filter given: analytic is
+    // the block filtered by a Hilbert<T> initialized by the filter taps, the sample rate and the block size
+    // of the processor. Lets the processors of several propagation conditions share a single filter,
+    // the output is the same as of process_buffer().
+    void process_buffer_analytic(T *buffer, cmplx_block<const T> analytic);
+
+    // Streaming interface: process any number of samples, keeping the state between the calls.
+    // The input is collected into blocks, so the output lags the input by block_size() samples
+    // plus the group delay of the input band pass filter, see latency(). out may be the same as in.
+    void process(const T *in, T *out, size_t n);
+    // Delay of the output of process() behind its input in samples.
+    int  latency() const;
+
+    // process_buffer() split into three stages for the pipelined processor. The stages touch disjoint
+    // state, so that each one may run on its own thread, each on a different block, the blocks passing
+    // through the stages in order. The output is the same as of process_buffer().
+    struct Frame
+    {
+        // Samples of the block, processed in place.
+        std::vector<T>      samples;
+        // Delayed analytic signal of each path.
+        Arena<T>            taps;
+        // Gains of the signal and of the noise for the block.
+        double              signal_gain     { 1. };
+        double              noise_rms       { 0. };
+    };
+    // Allocate the buffers of a frame.
+    void init_frame(Frame &frame) const;
+    // Level measurement, band pass filter and delay line, the taps are copied into the frame.
+    void stage_analyze(Frame &frame);
+    // Fading and Doppler of the paths, summed into the samples.
+    void stage_paths(Frame &frame);
+    // Scaling and the noise.
+    void stage_noise(Frame &frame);
 
 private:
+    // Update the average input RMS by the block, then the gains of the signal and of the noise.
+    void update_levels(const T *buffer);
+    // The rest of process_buffer() once the analytic signal of the block is in the delay line.
+    void process_delayed(T *buffer);
+    // Task i of a block of the worker pool: path i into its buffer, the last one the noise of the next block.
+    static void run_task(void *context, int i);
+
     // RMS of the input signal, absolute value.
     double                  m_SigRMS 		{ 0. };
     // Gain factor to apply to the input signal to maintain reasonable dynamic range on 16bit WAVs.
@@ -32,14 +89,31 @@ private:
     // Input SNR parameter, fraction, not dB
     double                  m_SNR 			{ 0. };
 
-    struct PathWithBuffer {
-        Path                path;
-        std::vector<cmplx>  buffer;
-    };
-    std::vector<PathWithBuffer> m_paths;
-    Hilbert                 m_hilbert;
-    Delay                   m_delay;
-    NoiseGen                m_noise_gen;
+    double                  m_sample_rate   { MIN_SAMPLE_RATE };
+    int                     m_block_size    { BUF_SIZE };
+    // Weight of a block in the IIR average of the input RMS, proportional to the block length.
+    double                  m_rms_weight    { 0. };
+
+    // FIFOs of process(): input being collected and output of the last block, m_fifo_fill samples of each used.
+    std::vector<T>          m_fifo_in;
+    std::vector<T>          m_fifo_out;
+    int                     m_fifo_fill     { 0 };
+
+    std::vector<Path<T>>    m_paths;
+    Hilbert<T>              m_hilbert;
+    Delay<T>                m_delay;
+    NoiseGen<T>             m_noise_gen;
+
+    // Threaded evaluation, PathSimParams::threads > 1: each path is calculated into its own block
+    // of m_path_out, the blocks are summed in the order of the paths as by the serial code.
+    WorkerPool              m_pool;
+    bool                    m_threaded      { false };
+    std::vector<T>          m_path_out;
+    // Band limited unit noise of the current block and of the next one, generated ahead by the threaded
+    // evaluation. The noise of the SNR sweep is generated into m_noise_block as well.
+    std::vector<T>          m_noise_block;
+    std::vector<T>          m_noise_next;
+    bool                    m_noise_ready   { false };
 
     PathSimParams           m_params;
 
@@ -50,6 +124,49 @@ private:
     State                   m_state;
 };
 
+// Runs the PathSimProcessor at INTERNAL_SAMPLE_RATE: the input is converted down to it and the output
+// back up to the sample rate of the input by polyphase resamplers. The whole chain then runs at the low
+// rate, which at 44.1 or 48 kHz costs much less than processing at the native rate. The resamplers pass
+// the channel band flat, their aliases and images fall outside of it.
+template<typename T>
+class ResamplingProcessor
+{
+public:
+    static constexpr int INTERNAL_SAMPLE_RATE = 8000;
+
+    // The sample rate has to be a whole number of Hz, PathSimProcessor::MIN_SAMPLE_RATE to MAX_SAMPLE_RATE.
+    // At INTERNAL_SAMPLE_RATE the samples are passed to the processor unchanged.
+    void init(const PathSimParams &params, double sample_rate);
+
+    // Streaming interface, see PathSimProcessor::process(). out may be the same as in.
+    void process(const T *in, T *out, size_t n);
+    // Delay of the output of process() behind its input in samples, rounded.
+    int  latency() const;
+    // The part of latency() added by the resamplers and by the collecting of the blocks. The rest is
+    // the group delay of the channel band pass filter, which delays the output at the native rate as well.
+    int  resampling_delay() const;
+
+    const PathSimProcessor<T>&  processor()      const { return m_processor; }
+    const Resampler<T>&         down_converter() const { return m_down; }
+    const Resampler<T>&         up_converter()   const { return m_up; }
+
+private:
+    // Input samples converted at a time.
+    static constexpr int CHUNK = 512;
+
+    PathSimProcessor<T>     m_processor;
+    Resampler<T>            m_down;
+    Resampler<T>            m_up;
+    bool                    m_resample      { false };
+    // Input samples per sample of the processor.
+    double                  m_ratio         { 1. };
+    // A chunk converted down and processed.
+    std::vector<T>          m_low;
+    // Output converted up, not yet returned by process(), m_fifo_fill samples used.
+    std::vector<T>          m_fifo;
+    int                     m_fifo_fill     { 0 };
+};
+
 } // namespace PathSim
 
 #endif // PATHSIM_PROCESSOR_HPP
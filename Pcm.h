@@ -0,0 +1,275 @@
+// Vectorized conversions between the PCM samples of the audio files and the float or double samples
+// of the processing chain.
+//
+// SSE2 on any x86-64, plain C++ otherwise. The multi-byte samples are little endian, as in WAV files.
+// The conversions without dither give the same samples as AudioFile for samples within the full scale:
+// the 16 and 24 bit samples truncated, the 8 bit ones offset binary. All of them are clamped to the full scale,
+// where AudioFile wraps the 24 bit samples around.
+
+#ifndef PATHSIM_PCM_HPP
+#define PATHSIM_PCM_HPP
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include "Simd.h"
+
+namespace PathSim {
+
+// TPDF dither: the difference of two independent uniform deviates of 0 to 1 LSB,
+// a triangular density over -1 to +1 LSB. A xorshift64* generator, reproducible from the seed.
+class TpdfDither
+{
+public:
+	void init(uint64_t seed)
+	{
+		m_state = (seed + 1) * 0x9E3779B97F4A7C15ull;
+		if (m_state == 0)
+			m_state = 1;
+	}
+
+	void generate(double *out, size_t n)
+	{
+		for (size_t i = 0; i < n; ++ i) {
+			m_state ^= m_state >> 12;
+			m_state ^= m_state << 25;
+			m_state ^= m_state >> 27;
+			const uint64_t r = m_state * 0x2545F4914F6CDD1Dull;
+			// Two 24 bit uniform deviates out of the upper 48 bits.
+			out[i] = double(r >> 40) * (1. / 16777216.) - double((r >> 16) & 0xFFFFFF) * (1. / 16777216.);
+		}
+	}
+
+private:
+	uint64_t m_state { 1 };
+};
+
+#if defined(__SSE2__)
+// Four samples widened to double.
+static inline void load_pd4(const double *p, __m128d &a, __m128d &b) { a = _mm_loadu_pd(p); b = _mm_loadu_pd(p + 2); }
+static inline void load_pd4(const float *p, __m128d &a, __m128d &b)
+{
+	__m128 x = _mm_loadu_ps(p);
+	a = _mm_cvtps_pd(x);
+	b = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+}
+
+// Four 32 bit integers times scale, stored as samples. Exact for a power of two scale.
+static inline void store_scaled(__m128i v, double scale, double *out)
+{
+	const __m128d s = _mm_set1_pd(scale);
+	_mm_storeu_pd(out,     _mm_mul_pd(_mm_cvtepi32_pd(v), s));
+	_mm_storeu_pd(out + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))), s));
+}
+static inline void store_scaled(__m128i v, double scale, float *out)
+{
+	_mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(float(scale))));
+}
+
+// Four float samples stored as samples.
+static inline void store_ps4(__m128 v, double *out)
+{
+	_mm_storeu_pd(out,     _mm_cvtps_pd(v));
+	_mm_storeu_pd(out + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+}
+static inline void store_ps4(__m128 v, float *out) { _mm_storeu_ps(out, v); }
+
+// Four samples to 32 bit integers: clamped to -lim .. +lim, times scale, plus the dither if not null,
+// then rounded to the nearest if dithered, truncated otherwise.
+template<typename T>
+static inline __m128i quantize4(const T *in, const double *dither, double lim, double scale)
+{
+	__m128d a, b;
+	load_pd4(in, a, b);
+	const __m128d hi = _mm_set1_pd(lim);
+	const __m128d lo = _mm_set1_pd(- lim);
+	a = _mm_max_pd(_mm_min_pd(a, hi), lo);
+	b = _mm_max_pd(_mm_min_pd(b, hi), lo);
+	const __m128d s = _mm_set1_pd(scale);
+	a = _mm_mul_pd(a, s);
+	b = _mm_mul_pd(b, s);
+	if (dither != nullptr) {
+		a = _mm_add_pd(a, _mm_loadu_pd(dither));
+		b = _mm_add_pd(b, _mm_loadu_pd(dither + 2));
+		return _mm_unpacklo_epi64(_mm_cvtpd_epi32(a), _mm_cvtpd_epi32(b));
+	}
+	return _mm_unpacklo_epi64(_mm_cvttpd_epi32(a), _mm_cvttpd_epi32(b));
+}
+#endif
+
+// Decoders: n samples of the first channel of interleaved frames of frame_size bytes.
+// The 16 and 24 bit and the float decoders are vectorized, the 8 bit one is left scalar.
+
+template<typename T>
+static inline void decode_pcm8(const uint8_t *in, int frame_size, T *out, size_t n)
+{
+	for (size_t i = 0; i < n; ++ i, in += frame_size)
+		out[i] = static_cast<T>(int(in[0]) - 128) / static_cast<T>(128.);
+}
+
+template<typename T>
+static inline void decode_pcm16(const uint8_t *in, int frame_size, T *out, size_t n)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	if (frame_size == 2)
+		for (; i + 8 <= n; i += 8, in += 16) {
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+			// Sign extended by the arithmetic shift of the samples moved to the upper halves.
+			store_scaled(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16), 1. / 32768., out + i);
+			store_scaled(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16), 1. / 32768., out + i + 4);
+		}
+#endif
+	for (; i < n; ++ i, in += frame_size)
+		out[i] = static_cast<T>(int16_t(in[0] | (in[1] << 8))) / static_cast<T>(32768.);
+}
+
+template<typename T>
+static inline void decode_pcm24(const uint8_t *in, int frame_size, T *out, size_t n)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	// Each sample is loaded as a 32 bit word with the first byte of the next frame on top, which
+	// the shifts replace by the sign extension. Thus the last frame is left to the scalar loop.
+	for (; i + 4 < n; i += 4, in += 4 * frame_size) {
+		uint32_t w[4];
+		for (int k = 0; k < 4; ++ k)
+			memcpy(w + k, in + k * frame_size, 4);
+		__m128i v = _mm_set_epi32(int(w[3]), int(w[2]), int(w[1]), int(w[0]));
+		store_scaled(_mm_srai_epi32(_mm_slli_epi32(v, 8), 8), 1. / 8388608., out + i);
+	}
+#endif
+	for (; i < n; ++ i, in += frame_size) {
+		int32_t v = (in[2] << 16) | (in[1] << 8) | in[0];
+		if (v & 0x800000)
+			v |= ~0xFFFFFF;
+		out[i] = (T)v / (T)8388608.;
+	}
+}
+
+template<typename T>
+static inline void decode_float32(const uint8_t *in, int frame_size, T *out, size_t n)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	const float *f = reinterpret_cast<const float*>(in);
+	if (frame_size == 4)
+		for (; i + 4 <= n; i += 4, in += 16, f += 4)
+			store_ps4(_mm_loadu_ps(f), out + i);
+	else if (frame_size == 8)
+		// The first channel of the stereo frames: the even samples of two vectors.
+		for (; i + 4 <= n; i += 4, in += 32, f += 8)
+			store_ps4(_mm_shuffle_ps(_mm_loadu_ps(f), _mm_loadu_ps(f + 4), _MM_SHUFFLE(2, 0, 2, 0)), out + i);
+#endif
+	for (; i < n; ++ i, in += frame_size) {
+		float v;
+		memcpy(&v, in, sizeof(v));
+		out[i] = T(v);
+	}
+}
+
+// Encoders of n mono samples into out. dither: n dither values in LSB, or null for none.
+
+// The 8 bit samples are never dithered, AudioFile rounds the offset binary sample in the sample type.
+template<typename T>
+static inline void encode_pcm8(const T *in, uint8_t *out, size_t n)
+{
+	for (size_t i = 0; i < n; ++ i) {
+		T sample = std::max(std::min(in[i], T(1.)), T(-1.));
+		sample = (sample + 1.) / 2.;
+		out[i] = static_cast<uint8_t>(sample * 255.);
+	}
+}
+
+// Clamped to -1 .. 1 and scaled by 32767, the largest sample of either sign.
+template<typename T>
+static inline void encode_pcm16(const T *in, const double *dither, uint8_t *out, size_t n)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	for (; i + 8 <= n; i += 8) {
+		__m128i a = quantize4(in + i,     dither ? dither + i : nullptr,     1., 32767.);
+		__m128i b = quantize4(in + i + 4, dither ? dither + i + 4 : nullptr, 1., 32767.);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), _mm_packs_epi32(a, b));
+	}
+#endif
+	for (; i < n; ++ i) {
+		const T sample = std::max(std::min(in[i], T(1.)), T(-1.));
+		int v = dither ? std::max(-32768, std::min(32767, int(lrint(sample * 32767. + dither[i])))) : static_cast<int16_t>(sample * 32767.);
+		out[2 * i]     = uint8_t(v);
+		out[2 * i + 1] = uint8_t(v >> 8);
+	}
+}
+
+// Scaled by 2^23, plus the dither if any, and clamped to the 24 bit range, so that the full scale +1
+// does not wrap around to the negative full scale.
+template<typename T>
+static inline void encode_pcm24(const T *in, const double *dither, uint8_t *out, size_t n)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	alignas(16) int32_t v[4];
+	const __m128d s  = _mm_set1_pd(8388608.);
+	const __m128d hi = _mm_set1_pd(8388607.);
+	const __m128d lo = _mm_set1_pd(-8388608.);
+	for (; i + 4 <= n; i += 4) {
+		__m128d a, b;
+		load_pd4(in + i, a, b);
+		a = _mm_mul_pd(a, s);
+		b = _mm_mul_pd(b, s);
+		__m128i q;
+		if (dither != nullptr) {
+			a = _mm_max_pd(_mm_min_pd(_mm_add_pd(a, _mm_loadu_pd(dither + i)),     hi), lo);
+			b = _mm_max_pd(_mm_min_pd(_mm_add_pd(b, _mm_loadu_pd(dither + i + 2)), hi), lo);
+			q = _mm_unpacklo_epi64(_mm_cvtpd_epi32(a), _mm_cvtpd_epi32(b));
+		} else {
+			a = _mm_max_pd(_mm_min_pd(a, hi), lo);
+			b = _mm_max_pd(_mm_min_pd(b, hi), lo);
+			q = _mm_unpacklo_epi64(_mm_cvttpd_epi32(a), _mm_cvttpd_epi32(b));
+		}
+		_mm_store_si128(reinterpret_cast<__m128i*>(v), q);
+		for (int k = 0; k < 4; ++ k) {
+			uint8_t *p = out + 3 * (i + k);
+			p[0] = uint8_t(v[k]);
+			p[1] = uint8_t(v[k] >> 8);
+			p[2] = uint8_t(v[k] >> 16);
+		}
+	}
+#endif
+	for (; i < n; ++ i) {
+		const double x = std::max(-8388608., std::min(8388607., double(in[i]) * 8388608. + (dither ? dither[i] : 0.)));
+		const int32_t v = dither ? int32_t(lrint(x)) : int32_t(x);
+		uint8_t *p = out + 3 * i;
+		p[0] = uint8_t(v);
+		p[1] = uint8_t(v >> 8);
+		p[2] = uint8_t(v >> 16);
+	}
+}
+
+static inline void encode_float32(const float *in, uint8_t *out, size_t n)
+{
+	memcpy(out, in, n * sizeof(float));
+}
+
+static inline void encode_float32(const double *in, uint8_t *out, size_t n)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	for (; i + 4 <= n; i += 4) {
+		__m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(in + i));
+		__m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2));
+		_mm_storeu_ps(reinterpret_cast<float*>(out + 4 * i), _mm_movelh_ps(lo, hi));
+	}
+#endif
+	for (; i < n; ++ i) {
+		const float v = float(in[i]);
+		memcpy(out + 4 * i, &v, sizeof(v));
+	}
+}
+
+} // namespace PathSim
+
+#endif // PATHSIM_PCM_HPP
@@ -0,0 +1,180 @@
+// Pipelined streaming processor, the stages of the chain on their own threads.
+
+#include "Pipeline.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+namespace PathSim {
+
+// A waiting stage polls its queue this many times before it sleeps until the queue is filled.
+static constexpr int SPIN_COUNT = 256;
+
+static uint64_t elapsed_ns(std::chrono::steady_clock::time_point t0)
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+}
+
+template<typename T>
+void PipelinedProcessor<T>::init(const PathSimParams &params, double sample_rate, int depth)
+{
+    this->stop();
+    PathSimParams stage_params = params;
+    stage_params.threads = 0;
+    m_processor.init(stage_params, sample_rate);
+    m_depth = std::max(1, depth);
+    m_frames.resize(m_depth);
+    for (Frame &frame : m_frames)
+        m_processor.init_frame(frame);
+    m_in_flight = 0;
+    // Room for all the frames and for the null frame stopping the pipeline.
+    for (SpscQueue<Frame*> &queue : m_queues)
+        queue.init(m_depth + 1);
+    for (Counters &c : m_counters) {
+        c.blocks    = 0;
+        c.stalls    = 0;
+        c.depth_sum = 0;
+        c.max_depth = 0;
+        c.busy_ns   = 0;
+        c.wait_ns   = 0;
+    }
+    m_fifo_in.assign(m_processor.block_size(), T(0));
+    m_fifo_out.assign(m_processor.block_size(), T(0));
+    m_fifo_fill = 0;
+    for (int s = 0; s < STAGE_OUTPUT; ++ s)
+        m_threads[s] = std::thread(&PipelinedProcessor<T>::stage_thread, this, s);
+}
+
+template<typename T>
+void PipelinedProcessor<T>::stop()
+{
+    if (! m_threads[0].joinable())
+        return;
+    this->put(0, nullptr);
+    for (std::thread &t : m_threads)
+        t.join();
+}
+
+template<typename T>
+typename PipelinedProcessor<T>::Frame* PipelinedProcessor<T>::take(int stage)
+{
+    SpscQueue<Frame*> &queue = m_queues[stage];
+    Counters          &c     = m_counters[stage];
+    Frame *frame = nullptr;
+    if (! queue.pop(frame)) {
+        auto t0 = std::chrono::steady_clock::now();
+        bool ready = false;
+        for (int i = 0; i < SPIN_COUNT && ! ready; ++ i)
+            ready = queue.pop(frame);
+        if (! ready) {
+            Waiter &w = m_waiters[stage];
+            std::unique_lock<std::mutex> lock(w.mutex);
+            w.waiting.store(true, std::memory_order_relaxed);
+            // Pairs with the fence of put(): either the producer sees waiting set and notifies
+            // under the mutex, or this pop sees the frame it pushed.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (! queue.pop(frame))
+                w.cv.wait(lock);
+            w.waiting.store(false, std::memory_order_relaxed);
+        }
+        c.stalls.fetch_add(1, std::memory_order_relaxed);
+        c.wait_ns.fetch_add(elapsed_ns(t0), std::memory_order_relaxed);
+    }
+    if (frame == nullptr)
+        return nullptr;
+    const uint64_t depth = queue.size() + 1;
+    c.blocks.fetch_add(1, std::memory_order_relaxed);
+    c.depth_sum.fetch_add(depth, std::memory_order_relaxed);
+    if (depth > c.max_depth.load(std::memory_order_relaxed))
+        c.max_depth.store(depth, std::memory_order_relaxed);
+    return frame;
+}
+
+template<typename T>
+void PipelinedProcessor<T>::put(int stage, Frame *frame)
+{
+    // Each queue has room for all the frames and the null frame, the push never fails.
+    m_queues[stage].push(frame);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    Waiter &w = m_waiters[stage];
+    if (w.waiting.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.cv.notify_one();
+    }
+}
+
+template<typename T>
+void PipelinedProcessor<T>::stage_thread(int stage)
+{
+    for (;;) {
+        Frame *frame = this->take(stage);
+        if (frame != nullptr) {
+            auto t0 = std::chrono::steady_clock::now();
+            switch (stage) {
+            case STAGE_ANALYZE: m_processor.stage_analyze(*frame); break;
+            case STAGE_PATHS:   m_processor.stage_paths(*frame); break;
+            case STAGE_NOISE:   m_processor.stage_noise(*frame); break;
+            }
+            m_counters[stage].busy_ns.fetch_add(elapsed_ns(t0), std::memory_order_relaxed);
+        }
+        this->put(stage + 1, frame);
+        if (frame == nullptr)
+            return;
+    }
+}
+
+// The input is collected into blocks as by PathSimProcessor::process(). A full block is handed
+// to the pipeline in a free frame, or once all the frames are in flight, in the frame of the oldest
+// block, which is taken back first and becomes the output.
+template<typename T>
+void PipelinedProcessor<T>::process(const T *in, T *out, size_t n)
+{
+    const int block_size = m_processor.block_size();
+    while (n > 0) {
+        const int len = int(std::min<size_t>(n, size_t(block_size - m_fifo_fill)));
+        // The input is read before the output is written, in and out may be the same.
+        memcpy(m_fifo_in.data() + m_fifo_fill, in, len * sizeof(T));
+        memcpy(out, m_fifo_out.data() + m_fifo_fill, len * sizeof(T));
+        in  += len;
+        out += len;
+        n   -= size_t(len);
+        m_fifo_fill += len;
+        if (m_fifo_fill == block_size) {
+            Frame *frame;
+            if (m_in_flight < m_depth)
+                frame = &m_frames[m_in_flight ++];
+            else {
+                frame = this->take(STAGE_OUTPUT);
+                m_fifo_out.swap(frame->samples);
+            }
+            frame->samples.swap(m_fifo_in);
+            this->put(STAGE_ANALYZE, frame);
+            m_fifo_fill = 0;
+        }
+    }
+}
+
+template<typename T>
+std::vector<typename PipelinedProcessor<T>::StageStats> PipelinedProcessor<T>::stats() const
+{
+    static const char *names[NUM_STAGES] = { "analyze", "paths", "noise", "output" };
+    std::vector<StageStats> out(NUM_STAGES);
+    for (int s = 0; s < NUM_STAGES; ++ s) {
+        const Counters &c = m_counters[s];
+        StageStats     &o = out[s];
+        o.name       = names[s];
+        o.blocks     = c.blocks.load(std::memory_order_relaxed);
+        o.stalls     = c.stalls.load(std::memory_order_relaxed);
+        o.mean_depth = o.blocks ? double(c.depth_sum.load(std::memory_order_relaxed)) / double(o.blocks) : 0.;
+        o.max_depth  = c.max_depth.load(std::memory_order_relaxed);
+        o.busy       = double(c.busy_ns.load(std::memory_order_relaxed)) * 1e-9;
+        o.wait       = double(c.wait_ns.load(std::memory_order_relaxed)) * 1e-9;
+    }
+    return out;
+}
+
+template class PipelinedProcessor<float>;
+template class PipelinedProcessor<double>;
+
+} // namespace PathSim
@@ -0,0 +1,123 @@
+// Pipelined streaming processor, the stages of the chain on their own threads.
+
+#ifndef PATHSIM_PIPELINE_HPP
+#define PATHSIM_PIPELINE_HPP
+
+#include "PathSimProcessor.h"
+#include "SpscQueue.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PathSim {
+
+// Runs the stages of PathSimProcessor (analysis: level, band pass and delay line; paths; noise)
+// each on its own thread, handing the blocks from one stage to the next through lock free
+// single producer, single consumer queues. The throughput is bounded by the slowest stage
+// instead of by the sum of the stages, at the cost of a latency of depth more blocks.
+// The output is the same as of PathSimProcessor.
+template<typename T>
+class PipelinedProcessor
+{
+public:
+    static constexpr int DEFAULT_DEPTH = 4;
+
+    enum Stage {
+        STAGE_ANALYZE,
+        STAGE_PATHS,
+        STAGE_NOISE,
+        // The caller of process() collecting the processed blocks.
+        STAGE_OUTPUT,
+        NUM_STAGES
+    };
+
+    struct StageStats
+    {
+        const char *name;
+        // Blocks taken from the input queue of the stage.
+        uint64_t    blocks;
+        // Times the input queue was found empty, so that the stage had to wait for the previous one.
+        uint64_t    stalls;
+        // Blocks in the input queue when a block was taken, including that one: average and maximum.
+        double      mean_depth;
+        uint64_t    max_depth;
+        // Time spent processing the blocks and waiting for them, seconds. The output stage only waits.
+        double      busy;
+        double      wait;
+    };
+
+    PipelinedProcessor() {}
+    ~PipelinedProcessor() { this->stop(); }
+    PipelinedProcessor(const PipelinedProcessor&) = delete;
+    PipelinedProcessor& operator=(const PipelinedProcessor&) = delete;
+
+    // depth: blocks in flight between the stages, at least 1.
+    // PathSimParams::threads is ignored, the pipeline has threads of its own.
+    void init(const PathSimParams &params, double sample_rate, int depth = DEFAULT_DEPTH);
+
+    int  block_size() const { return m_processor.block_size(); }
+    // Streaming interface, see PathSimProcessor::process(). out may be the same as in.
+    void process(const T *in, T *out, size_t n);
+    // Delay of the output of process() behind its input in samples: depth + 1 blocks plus the group delay.
+    int  latency() const { return m_depth * m_processor.block_size() + m_processor.latency(); }
+    // The part of latency() added by collecting the blocks and by the pipeline. The rest is the group delay
+    // of the channel band pass filter, which delays the output of PathSimProcessor::process_buffer() as well.
+    int  pipeline_delay() const { return (m_depth + 1) * m_processor.block_size(); }
+
+    // Counters of the stages since init(), indexed by Stage. May be read while processing.
+    std::vector<StageStats> stats() const;
+
+private:
+    typedef typename PathSimProcessor<T>::Frame Frame;
+
+    struct Counters
+    {
+        std::atomic<uint64_t>   blocks      { 0 };
+        std::atomic<uint64_t>   stalls      { 0 };
+        std::atomic<uint64_t>   depth_sum   { 0 };
+        std::atomic<uint64_t>   max_depth   { 0 };
+        std::atomic<uint64_t>   busy_ns     { 0 };
+        std::atomic<uint64_t>   wait_ns     { 0 };
+    };
+
+    // Wakes the consumer of a queue sleeping on its empty queue.
+    struct Waiter
+    {
+        std::mutex              mutex;
+        std::condition_variable cv;
+        // Set by the consumer before it checks the queue for the last time and goes to sleep.
+        std::atomic<bool>       waiting     { false };
+    };
+
+    // Stop the threads, passing a null frame down the pipeline.
+    void   stop();
+    void   stage_thread(int stage);
+    // Take a frame from the input queue of the stage, waiting while it is empty. Null stops the stage.
+    Frame* take(int stage);
+    // Hand a frame to the input queue of the stage and wake the stage if it sleeps.
+    void   put(int stage, Frame *frame);
+
+    PathSimProcessor<T>     m_processor;
+    int                     m_depth         { DEFAULT_DEPTH };
+    std::vector<Frame>      m_frames;
+    // Frames handed to the pipeline and not yet taken back, up to m_depth.
+    int                     m_in_flight     { 0 };
+    // m_queues[s] is the input of stage s, m_queues[STAGE_OUTPUT] holds the processed blocks.
+    SpscQueue<Frame*>       m_queues[NUM_STAGES];
+    Counters                m_counters[NUM_STAGES];
+    Waiter                  m_waiters[NUM_STAGES];
+    std::thread             m_threads[STAGE_OUTPUT];
+
+    // Input being collected and the output of the last block taken back, as by PathSimProcessor::process().
+    std::vector<T>          m_fifo_in;
+    std::vector<T>          m_fifo_out;
+    int                     m_fifo_fill     { 0 };
+};
+
+} // namespace PathSim
+
+#endif // PATHSIM_PIPELINE_HPP
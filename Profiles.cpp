@@ -0,0 +1,183 @@
+// Several propagation conditions or realizations simulated over a single input file.
+
+#include "Profiles.h"
+#include "PathSimProcessor.h"
+#include "WorkerPool.h"
+#include "AudioFile.h"
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+namespace PathSim {
+
+struct ProfileResult
+{
+	bool        ok          { false };
+	std::string error;
+	// Time of the processing alone and of the processing and saving, seconds.
+	double      process     { 0. };
+	double      total       { 0. };
+	// RMS of the output relative to the full scale, dB.
+	double      rms_db      { 0. };
+};
+
+// State of a thread of the pool, see run_job_queue().
+template<typename T>
+struct ProfileWorker
+{
+	PathSimProcessor<T> processor;
+	std::vector<T>      samples;
+};
+
+// The input shared read only by the jobs.
+template<typename T>
+struct ProfilesInput
+{
+	// Input padded to whole blocks and its analytic signal, a block per block of the input.
+	// The analytic signal is empty if none of the jobs has paths.
+	const std::vector<T>                             *input;
+	const Arena<T>                                   *analytic;
+	size_t                                            len;
+	double                                            sample_rate;
+	// Channels and sample format of the input, and the format of the outputs.
+	int                                               channels;
+	SampleFormat                                      input_format;
+	const OutputFormat                               *format;
+};
+
+template<typename T>
+static void run_profile(const ProfilesInput<T> &shared, const ProfileJob &job, ProfileWorker<T> &worker, ProfileResult &result)
+{
+	auto t0 = std::chrono::steady_clock::now();
+	PathSimProcessor<T> &processor = worker.processor;
+	processor.init(job.params, shared.sample_rate);
+	std::vector<T> &samples = worker.samples;
+	samples.assign(shared.input->begin(), shared.input->end());
+	const int    bufsize = processor.block_size();
+	const int    nblocks = int(samples.size() / bufsize);
+	// The analytic signal is only calculated if some job has paths, the direct path does not need it.
+	if (job.params.paths.empty())
+		for (int i = 0; i < nblocks; ++ i)
+			processor.process_buffer(samples.data() + size_t(i) * bufsize);
+	else
+		for (int i = 0; i < nblocks; ++ i)
+			processor.process_buffer_analytic(samples.data() + size_t(i) * bufsize, shared.analytic->block(i));
+	result.process = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	samples.resize(shared.len);
+	double acc = 0.;
+	for (T s : samples)
+		acc += double(s) * double(s);
+	result.rms_db = 10. * log10(std::max(acc / double(std::max<size_t>(shared.len, 1)), 1e-30));
+	OutputFormat format = *shared.format;
+	format.dither_seed = job.params.seed;
+	if (! write_wav_file(job.output_file, samples.data(), shared.len, uint32_t(shared.sample_rate), shared.channels, shared.input_format, format)) {
+		result.error = "failed saving output file";
+		return;
+	}
+	result.total = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	result.ok    = true;
+}
+
+template<typename T>
+static bool run_jobs(const std::vector<ProfileJob> &jobs, const std::string &input_file, int threads, const OutputFormat &format,
+	std::vector<ProfileResult> &results, double &duration, double &filter_time, std::ostream &out)
+{
+	AudioFile<T> audio_file;
+	audio_file.shouldLogErrorsToConsole(false);
+	if (! audio_file.load(input_file)) {
+		out << "failed loading input file: " << input_file << std::endl;
+		return false;
+	}
+	const double sample_rate = audio_file.getSampleRate();
+	if (sample_rate < PathSimProcessor<T>::MIN_SAMPLE_RATE || sample_rate > PathSimProcessor<T>::MAX_SAMPLE_RATE) {
+		out << "unsupported sample rate " << sample_rate << " Hz" << std::endl;
+		return false;
+	}
+
+	ProfilesInput<T> shared;
+	shared.sample_rate  = sample_rate;
+	shared.channels     = audio_file.getNumChannels();
+	shared.input_format = pcm_format(audio_file.getBitDepth());
+	shared.format       = &format;
+
+	// The block size of the processors, the same for all the jobs.
+	auto t0 = std::chrono::steady_clock::now();
+	PathSimProcessor<T> probe;
+	probe.init(jobs.front().params, sample_rate);
+	const int bufsize = probe.block_size();
+	std::vector<T> &input = audio_file.samples.front();
+	shared.len = input.size();
+	const int nblocks = int((input.size() + bufsize - 1) / bufsize);
+	input.resize(size_t(nblocks) * bufsize, T(0));
+	shared.input = &input;
+	Arena<T> analytic;
+	if (std::any_of(jobs.begin(), jobs.end(), [](const ProfileJob &job){ return ! job.params.paths.empty(); })) {
+		Hilbert<T> hilbert;
+		hilbert.init(jobs.front().params.filter_taps, sample_rate, bufsize);
+		analytic.init(nblocks, bufsize);
+		for (int i = 0; i < nblocks; ++ i)
+			hilbert.filter_block(input.data() + size_t(i) * bufsize, analytic.block(i));
+	}
+	shared.analytic = &analytic;
+	filter_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	duration    = double(shared.len) / sample_rate;
+
+	run_job_queue<ProfileWorker<T>>(jobs.size(), threads, [&](size_t i, ProfileWorker<T> &worker) {
+		run_profile(shared, jobs[i], worker, results[i]);
+	});
+	return true;
+}
+
+int run_profiles(const std::vector<ProfileJob> &jobs, const std::string &input_file, int threads, bool single_precision,
+	const OutputFormat &format, std::ostream &out)
+{
+	if (jobs.empty())
+		return 0;
+	for (const ProfileJob &job : jobs) {
+		(void)job;
+		assert(job.params.filter_taps == jobs.front().params.filter_taps && job.params.block_size == jobs.front().params.block_size);
+	}
+	threads = std::max(1, std::min(threads, int(jobs.size())));
+	std::vector<ProfileResult> results(jobs.size());
+	double duration    = 0.;
+	double filter_time = 0.;
+	auto t0 = std::chrono::steady_clock::now();
+	bool loaded = single_precision ?
+		run_jobs<float> (jobs, input_file, threads, format, results, duration, filter_time, out) :
+		run_jobs<double>(jobs, input_file, threads, format, results, duration, filter_time, out);
+	if (! loaded)
+		return -1;
+	double wall = std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+
+	int failed = 0;
+	out << std::left << std::setw(20) << "condition" << std::right << std::setw(7) << "paths" << std::setw(8) << "SNR"
+		<< std::setw(21) << "seed"
+		<< std::setw(12) << "process ms" << std::setw(10) << "RMS dB" << "  output" << std::endl;
+	for (size_t i = 0; i < jobs.size(); ++ i) {
+		const PathSimParams &params = jobs[i].params;
+		const ProfileResult &r      = results[i];
+		out << std::fixed << std::left << std::setw(20) << (params.cmdline_param.empty() ? "(command line)" : params.cmdline_param)
+			<< std::right << std::setw(7) << params.paths.size() << std::setw(8);
+		if (params.noise.has_awgn)
+			out << std::setprecision(1) << params.noise.snr;
+		else
+			out << "-";
+		out << std::setw(21) << params.seed;
+		if (! r.ok) {
+			out << "  " << r.error << ": " << jobs[i].output_file << std::endl;
+			++ failed;
+			continue;
+		}
+		out << std::setprecision(3) << std::setw(12) << r.process * 1000. << std::setprecision(1) << std::setw(10) << r.rms_db
+			<< "  " << jobs[i].output_file << std::endl;
+	}
+	out << std::fixed << "profiles: " << jobs.size() << " simulations, " << failed << " failed, " << threads << " threads, "
+		<< std::setprecision(3) << duration << " s of input in " << wall << " s (band pass filter " << filter_time * 1000. << " ms): "
+		<< std::setprecision(1) << double(jobs.size()) * duration / wall << "x realtime" << std::endl;
+	return failed;
+}
+
+} // namespace PathSim
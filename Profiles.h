@@ -0,0 +1,34 @@
+// Several propagation conditions or realizations simulated over a single input file.
+
+#ifndef PATHSIM_PROFILES_HPP
+#define PATHSIM_PROFILES_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "PathSimParams.h"
+#include "WavStream.h"
+
+namespace PathSim {
+
+struct ProfileJob
+{
+	PathSimParams   params;
+	std::string     output_file;
+};
+
+// Simulate each job over the input file into its output file: the propagation conditions, or the realizations
+// of a condition differing by PathSimParams::seed for a Monte Carlo simulation. The input is loaded
+// once and filtered into the analytic signal once, see PathSimProcessor::process_buffer_analytic(), the jobs
+// then share it read only, each processed by a single thread of a pool of threads. The output of each job
+// is the same as of the job simulated alone, whatever the number of the threads. All the jobs have to share
+// PathSimParams::filter_taps and PathSimParams::block_size. The outputs are written in the format, each dithered
+// by the seed of its job. Reports a table of the jobs and the throughput to out.
+// Returns the number of the failed jobs, or -1 if the input could not be loaded.
+extern int run_profiles(const std::vector<ProfileJob> &jobs, const std::string &input_file, int threads, bool single_precision,
+	const OutputFormat &format, std::ostream &out);
+
+} // namespace PathSim
+
+#endif // PATHSIM_PROFILES_HPP
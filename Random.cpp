@@ -0,0 +1,184 @@
+// Counter based Gaussian random number generator.
+
+#include "Random.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace PathSim {
+
+static constexpr double PI2 = 6.283185307179586476925286766559;
+static constexpr double LN2 = 0.69314718055994530941723212145818;
+
+// Philox4x32 with 10 rounds for a batch of counters stored as structure of arrays,
+// so that the 32x32->64 bit multiplications of neighbor counters run in SIMD lanes.
+static inline void philox4x32_10(uint32_t *c0, uint32_t *c1, uint32_t *c2, uint32_t *c3, int n, uint32_t k0, uint32_t k1)
+{
+	static constexpr uint32_t M0 = 0xD2511F53;
+	static constexpr uint32_t M1 = 0xCD9E8D57;
+	static constexpr uint32_t W0 = 0x9E3779B9;
+	static constexpr uint32_t W1 = 0xBB67AE85;
+	for (int round = 0; round < 10; ++ round) {
+		for (int i = 0; i < n; ++ i) {
+			uint64_t p0 = uint64_t(M0) * c0[i];
+			uint64_t p1 = uint64_t(M1) * c2[i];
+			uint32_t n0 = uint32_t(p1 >> 32) ^ c1[i] ^ k0;
+			uint32_t n2 = uint32_t(p0 >> 32) ^ c3[i] ^ k1;
+			c0[i] = n0;
+			c1[i] = uint32_t(p1);
+			c2[i] = n2;
+			c3[i] = uint32_t(p0);
+		}
+		k0 += W0;
+		k1 += W1;
+	}
+}
+
+// Uniform deviate in (0, 1) from 52 random bits, never zero.
+// Built by placing the bits into the mantissa of a double in <1, 2), which vectorizes
+// unlike an integer to floating point conversion of a 64bit integer.
+static inline double uniform_open(uint32_t hi, uint32_t lo)
+{
+	uint64_t bits = (((uint64_t(hi) << 32) | lo) >> 12) | 0x3FF0000000000000ull;
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return (d - 1.) + 0x1p-53;
+}
+
+// Natural logarithm of a positive normal number: x = m * 2^e with m in <sqrt(1/2), sqrt(2)),
+// log(m) = 2 atanh(z), z = (m - 1) / (m + 1), |z| < 0.172, evaluated as a series in z^2.
+// Branch free, accurate to a few ULPs.
+static inline double fast_log(double x)
+{
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	// Exponent relative to sqrt(1/2), so that the mantissa falls into <sqrt(1/2), sqrt(2)).
+	// Biased by 1024 to stay positive, as SSE2 / AVX2 have no 64bit arithmetic shift.
+	static constexpr uint64_t SQRT_HALF_BITS = 0x3FE6A09E667F3BCDull;
+	uint64_t ebiased = (bits - SQRT_HALF_BITS + (uint64_t(1024) << 52)) >> 52;
+	bits -= (ebiased - 1024) << 52;
+	double m;
+	memcpy(&m, &bits, sizeof(m));
+	// Exponent to double by the 2^52 magic number, as there is no SIMD 64bit integer conversion.
+	uint64_t ebits = 0x4330000000000000ull | ebiased;
+	double e;
+	memcpy(&e, &ebits, sizeof(e));
+	e -= 4503599627370496. + 1024.;
+	double z  = (m - 1.) / (m + 1.);
+	double z2 = z * z;
+	double s  = 1. / 23.;
+	s = s * z2 + 1. / 21.;
+	s = s * z2 + 1. / 19.;
+	s = s * z2 + 1. / 17.;
+	s = s * z2 + 1. / 15.;
+	s = s * z2 + 1. / 13.;
+	s = s * z2 + 1. / 11.;
+	s = s * z2 + 1. / 9.;
+	s = s * z2 + 1. / 7.;
+	s = s * z2 + 1. / 5.;
+	s = s * z2 + 1. / 3.;
+	s = s * z2 + 1.;
+	return 2. * z * s + e * LN2;
+}
+
+// cos and sin of 2 pi u for u in (0, 1). The angle is mapped to (-pi, pi), evaluated
+// by Taylor series at a quarter of the angle and brought back by two angle doublings.
+// Branch free, absolute error below 1e-15.
+static inline void fast_sincos_2pi(double u, double &c, double &s)
+{
+	double x  = 0.25 * PI2 * (u - 0.5);
+	double x2 = x * x;
+	// sin(x), cos(x) for |x| <= pi / 4
+	double ps = -1. / 1307674368000.;
+	ps = ps * x2 + 1. / 6227020800.;
+	ps = ps * x2 - 1. / 39916800.;
+	ps = ps * x2 + 1. / 362880.;
+	ps = ps * x2 - 1. / 5040.;
+	ps = ps * x2 + 1. / 120.;
+	ps = ps * x2 - 1. / 6.;
+	ps = ps * x2 + 1.;
+	double pc = 1. / 20922789888000.;
+	pc = pc * x2 - 1. / 87178291200.;
+	pc = pc * x2 + 1. / 479001600.;
+	pc = pc * x2 - 1. / 3628800.;
+	pc = pc * x2 + 1. / 40320.;
+	pc = pc * x2 - 1. / 720.;
+	pc = pc * x2 + 1. / 24.;
+	pc = pc * x2 - 1. / 2.;
+	pc = pc * x2 + 1.;
+	double sn = x * ps;
+	double cs = pc;
+	// Two angle doublings.
+	for (int i = 0; i < 2; ++ i) {
+		double s2 = 2. * sn * cs;
+		cs = (cs - sn) * (cs + sn);
+		sn = s2;
+	}
+	// The angle was shifted by pi, which flips the signs. This does not matter for the
+	// distribution, but keep the values equal to cos / sin of 2 pi u.
+	c = - cs;
+	s = - sn;
+}
+
+void Random::init(uint64_t seed, uint64_t stream)
+{
+	m_key[0] 	= uint32_t(seed);
+	m_key[1] 	= uint32_t(seed >> 32);
+	m_stream[0] = uint32_t(stream);
+	m_stream[1] = uint32_t(stream >> 32);
+	m_index 	= 0;
+}
+
+// Box-Muller transform: the pair of normal deviates 2k, 2k + 1 is generated from
+// the two uniform deviates of the Philox block with counter (k, stream).
+// The uniforms of a whole batch are generated first, then transformed by a loop
+// without any branches or dependencies between iterations.
+void Random::normal_block(double *out, int n)
+{
+	uint32_t c0[BATCH], c1[BATCH], c2[BATCH], c3[BATCH];
+	double   z[2 * BATCH];
+	while (n > 0) {
+		uint64_t pair  = m_index >> 1;
+		int      skip  = int(m_index & 1);
+		int      pairs = std::min(BATCH, (n + skip + 1) / 2);
+		for (int i = 0; i < pairs; ++ i) {
+			uint64_t k = pair + uint64_t(i);
+			c0[i] = uint32_t(k);
+			c1[i] = uint32_t(k >> 32);
+			c2[i] = m_stream[0];
+			c3[i] = m_stream[1];
+		}
+		philox4x32_10(c0, c1, c2, c3, pairs, m_key[0], m_key[1]);
+		for (int i = 0; i < pairs; ++ i) {
+			double r = sqrt(-2. * fast_log(uniform_open(c0[i], c1[i])));
+			double c, s;
+			fast_sincos_2pi(uniform_open(c2[i], c3[i]), c, s);
+			z[2 * i]     = r * c;
+			z[2 * i + 1] = r * s;
+		}
+		// Emit the deviates, possibly starting with the second one of the first pair
+		// and ending with the first one of the last pair.
+		int emitted = std::min(n, 2 * pairs - skip);
+		for (int i = 0; i < emitted; ++ i)
+			out[i] = z[skip + i];
+		out 	+= emitted;
+		n 		-= emitted;
+		m_index += emitted;
+	}
+}
+
+void Random::normal_block(float *out, int n)
+{
+	double tmp[2 * BATCH];
+	while (n > 0) {
+		int len = std::min(n, 2 * BATCH);
+		this->normal_block(tmp, len);
+		for (int i = 0; i < len; ++ i)
+			out[i] = float(tmp[i]);
+		out += len;
+		n   -= len;
+	}
+}
+
+} // namespace PathSim
@@ -0,0 +1,38 @@
+// Counter based Gaussian random number generator.
+
+#ifndef PATHSIM_RANDOM_HPP
+#define PATHSIM_RANDOM_HPP
+
+#include <stdint.h>
+
+namespace PathSim {
+
+// Philox4x32-10 counter based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// The k-th normal deviate of a stream is a pure function of (seed, stream, k), thus the sequence
+// does not depend on how it is split into blocks, on the order of calls between instances
+// or on the thread the instance runs on. Each instance keeps its own state, there is no global state.
+class Random
+{
+public:
+	// Streams of the same seed are statistically independent.
+	void 	init(uint64_t seed, uint64_t stream);
+
+	// Fill n normally distributed deviates with zero mean and unit variance,
+	// continuing the sequence of the previous call.
+	void 	normal_block(double *out, int n);
+	// Single precision variant, returns the same deviates rounded to float.
+	void 	normal_block(float *out, int n);
+
+private:
+	// Pairs of deviates generated per batch of the Box-Muller transform.
+	static constexpr int BATCH = 64;
+
+	uint32_t m_key[2];
+	uint32_t m_stream[2];
+	// Index of the next normal deviate.
+	uint64_t m_index { 0 };
+};
+
+} // namespace PathSim
+
+#endif // PATHSIM_RANDOM_HPP
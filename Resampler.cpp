@@ -0,0 +1,73 @@
+// Rational polyphase sample rate converter.
+
+#include "Resampler.h"
+#include "FilterDesign.h"
+#include "Simd.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+namespace PathSim {
+
+template<typename T>
+void Resampler<T>::init(int in_rate, int out_rate, double passband, double stopband, double attenuation_db)
+{
+	assert(in_rate > 0 && out_rate > 0 && passband < stopband);
+	int a = in_rate;
+	int b = out_rate;
+	while (b != 0) {
+		int r = a % b;
+		a = b;
+		b = r;
+	}
+	m_up   = out_rate / a;
+	m_down = in_rate / a;
+
+	// The filter runs at the upsampled rate, its length is rounded up to whole phases.
+	const double rate = double(in_rate) * double(m_up);
+	m_taps = std::max(1, (kaiser_taps(stopband - passband, rate, attenuation_db) + m_up - 1) / m_up);
+	std::vector<double> h = design_lowpass(m_taps * m_up, rate, 0.5 * (passband + stopband), kaiser_beta(attenuation_db));
+	// Zero stuffing divides the signal by m_up, each phase has unity DC gain.
+	m_coefs.assign(size_t(m_taps) * m_up, T(0));
+	for (int p = 0; p < m_up; ++ p)
+		for (int m = 0; m < m_taps; ++ m)
+			m_coefs[size_t(p) * m_taps + m] = T(h[size_t(p) + size_t(m_taps - 1 - m) * m_up] * m_up);
+
+	m_history.assign(m_taps - 1 + CHUNK, T(0));
+	m_fill  = m_taps - 1;
+	m_index = m_taps - 1;
+	m_phase = 0;
+}
+
+// Output sample k lies at k * m_down / m_up input samples. It is produced as soon as the input sample
+// it starts at is available, so n input samples yield ceil(n * m_up / m_down) output samples in total.
+template<typename T>
+int Resampler<T>::process(const T *in, int n, T *out)
+{
+	int produced = 0;
+	while (n > 0) {
+		const int len = std::min(n, int(CHUNK));
+		memcpy(m_history.data() + m_fill, in, len * sizeof(T));
+		m_fill += len;
+		in     += len;
+		n      -= len;
+		for (; m_index < m_fill; ++ produced) {
+			out[produced] = dot_product(m_coefs.data() + size_t(m_phase) * m_taps, m_history.data() + m_index + 1 - m_taps, m_taps);
+			m_phase += m_down;
+			m_index += m_phase / m_up;
+			m_phase %= m_up;
+		}
+		// Keep the last m_taps - 1 samples for the next chunk.
+		const int shift = m_fill + 1 - m_taps;
+		memmove(m_history.data(), m_history.data() + shift, (m_taps - 1) * sizeof(T));
+		m_fill  -= shift;
+		m_index -= shift;
+	}
+	return produced;
+}
+
+template class Resampler<float>;
+template class Resampler<double>;
+
+} // namespace PathSim
@@ -0,0 +1,56 @@
+// Rational polyphase sample rate converter.
+
+#ifndef PATHSIM_RESAMPLER_HPP
+#define PATHSIM_RESAMPLER_HPP
+
+#include <stdint.h>
+#include <vector>
+
+namespace PathSim {
+
+// Converts the sample rate by the rational factor up() / down(): conceptually the input is
+// upsampled by zero stuffing, low pass filtered and decimated. Only the retained output samples
+// are calculated and the zeros are skipped: the filter is split into up() phases of taps()
+// coefficients, each output sample is a dot product of one phase with the last taps() input samples.
+// process() streams, the state is kept between the calls.
+template<typename T>
+class Resampler
+{
+public:
+	// Convert from in_rate to out_rate (Hz). The low pass filter passes up to passband (Hz)
+	// and attenuates from stopband (Hz) up by attenuation_db.
+	void init(int in_rate, int out_rate, double passband, double stopband, double attenuation_db);
+
+	// Convert n input samples, return the number of output samples written to out.
+	// out has to hold max_output(n) samples and it must not overlap in.
+	int  process(const T *in, int n, T *out);
+	// Upper bound of the number of output samples of process() for n input samples.
+	int  max_output(int n) const { return int((int64_t(n) * m_up + m_down - 1) / m_down) + 1; }
+
+	int  up()   const { return m_up; }
+	int  down() const { return m_down; }
+	// Coefficients per phase, the length of the dot products.
+	int  taps() const { return m_taps; }
+	// Group delay of the low pass filter in output samples.
+	double group_delay() const { return 0.5 * double(m_taps * m_up - 1) / double(m_down); }
+
+private:
+	// Input samples appended to the history at a time.
+	static constexpr int CHUNK = 1024;
+
+	int             m_up        { 1 };
+	int             m_down      { 1 };
+	int             m_taps      { 1 };
+	// m_up phases of m_taps coefficients, each in reversed order.
+	std::vector<T>  m_coefs;
+	// Linear history: the last m_taps - 1 input samples followed by up to CHUNK new ones, m_fill used.
+	std::vector<T>  m_history;
+	int             m_fill      { 0 };
+	// The next output sample lies m_phase / m_up samples past the input sample m_index of the history.
+	int             m_index     { 0 };
+	int             m_phase     { 0 };
+};
+
+} // namespace PathSim
+
+#endif // PATHSIM_RESAMPLER_HPP
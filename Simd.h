@@ -0,0 +1,331 @@
+// Vectorized block kernels shared by the FIR filters.
+//
+// The kernels are selected at compile time: AVX2 / FMA if the compiler targets it
+// (see PATHSIM_AVX2 in CMakeLists.txt), SSE2 on any x86-64, plain C++ otherwise.
+
+#ifndef PATHSIM_SIMD_HPP
+#define PATHSIM_SIMD_HPP
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#ifndef __SSE2__
+		#define __SSE2__ 1
+	#endif
+#endif
+
+namespace PathSim {
+
+// Block FIR filter over a linear history buffer:
+//     out[i] = sum_{m = 0}^{taps - 1} in[i + m] * coef[m],  i = 0 .. n - 1
+// in[] has to hold n + taps - 1 samples and coef[] is the impulse response in reversed order,
+// so that each output sample is a dot product of two contiguous vectors.
+// The filter is evaluated for several output samples at once, each SIMD lane summing
+// over the taps in the same order as the scalar tail loop.
+static inline void fir_block(const double *in, const double *coef, int taps, double *out, int n)
+{
+	int i = 0;
+#if defined(__AVX2__)
+	for (; i + 8 <= n; i += 8) {
+		__m256d acc0 = _mm256_setzero_pd();
+		__m256d acc1 = _mm256_setzero_pd();
+		const double *p = in + i;
+		for (int m = 0; m < taps; ++ m, ++ p) {
+			__m256d c = _mm256_broadcast_sd(coef + m);
+		#ifdef __FMA__
+			acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(p), c, acc0);
+			acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(p + 4), c, acc1);
+		#else
+			acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(p), c));
+			acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(p + 4), c));
+		#endif
+		}
+		_mm256_storeu_pd(out + i, acc0);
+		_mm256_storeu_pd(out + i + 4, acc1);
+	}
+#elif defined(__SSE2__)
+	for (; i + 4 <= n; i += 4) {
+		__m128d acc0 = _mm_setzero_pd();
+		__m128d acc1 = _mm_setzero_pd();
+		const double *p = in + i;
+		for (int m = 0; m < taps; ++ m, ++ p) {
+			__m128d c = _mm_set1_pd(coef[m]);
+			acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(p), c));
+			acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(p + 2), c));
+		}
+		_mm_storeu_pd(out + i, acc0);
+		_mm_storeu_pd(out + i + 2, acc1);
+	}
+#endif
+	// Scalar tail.
+	for (; i < n; ++ i) {
+		double acc = 0.;
+		for (int m = 0; m < taps; ++ m)
+			acc += in[i + m] * coef[m];
+		out[i] = acc;
+	}
+}
+
+// Two block FIR filters sharing the same input:
+//     out1[i] = sum_m in[i + m] * coef1[m],  out2[i] = sum_m in[i + m] * coef2[m]
+// Each input vector is loaded once and multiplied by both coefficient sets,
+// which is how a real signal is converted to an analytic I/Q pair in a single pass.
+static inline void fir_block2(const double *in, const double *coef1, const double *coef2, int taps, double *out1, double *out2, int n)
+{
+	int i = 0;
+#if defined(__AVX2__)
+	for (; i + 8 <= n; i += 8) {
+		__m256d acc10 = _mm256_setzero_pd();
+		__m256d acc11 = _mm256_setzero_pd();
+		__m256d acc20 = _mm256_setzero_pd();
+		__m256d acc21 = _mm256_setzero_pd();
+		const double *p = in + i;
+		for (int m = 0; m < taps; ++ m, ++ p) {
+			__m256d x0 = _mm256_loadu_pd(p);
+			__m256d x1 = _mm256_loadu_pd(p + 4);
+			__m256d c1 = _mm256_broadcast_sd(coef1 + m);
+			__m256d c2 = _mm256_broadcast_sd(coef2 + m);
+		#ifdef __FMA__
+			acc10 = _mm256_fmadd_pd(x0, c1, acc10);
+			acc11 = _mm256_fmadd_pd(x1, c1, acc11);
+			acc20 = _mm256_fmadd_pd(x0, c2, acc20);
+			acc21 = _mm256_fmadd_pd(x1, c2, acc21);
+		#else
+			acc10 = _mm256_add_pd(acc10, _mm256_mul_pd(x0, c1));
+			acc11 = _mm256_add_pd(acc11, _mm256_mul_pd(x1, c1));
+			acc20 = _mm256_add_pd(acc20, _mm256_mul_pd(x0, c2));
+			acc21 = _mm256_add_pd(acc21, _mm256_mul_pd(x1, c2));
+		#endif
+		}
+		_mm256_storeu_pd(out1 + i, acc10);
+		_mm256_storeu_pd(out1 + i + 4, acc11);
+		_mm256_storeu_pd(out2 + i, acc20);
+		_mm256_storeu_pd(out2 + i + 4, acc21);
+	}
+#elif defined(__SSE2__)
+	for (; i + 4 <= n; i += 4) {
+		__m128d acc10 = _mm_setzero_pd();
+		__m128d acc11 = _mm_setzero_pd();
+		__m128d acc20 = _mm_setzero_pd();
+		__m128d acc21 = _mm_setzero_pd();
+		const double *p = in + i;
+		for (int m = 0; m < taps; ++ m, ++ p) {
+			__m128d x0 = _mm_loadu_pd(p);
+			__m128d x1 = _mm_loadu_pd(p + 2);
+			__m128d c1 = _mm_set1_pd(coef1[m]);
+			__m128d c2 = _mm_set1_pd(coef2[m]);
+			acc10 = _mm_add_pd(acc10, _mm_mul_pd(x0, c1));
+			acc11 = _mm_add_pd(acc11, _mm_mul_pd(x1, c1));
+			acc20 = _mm_add_pd(acc20, _mm_mul_pd(x0, c2));
+			acc21 = _mm_add_pd(acc21, _mm_mul_pd(x1, c2));
+		}
+		_mm_storeu_pd(out1 + i, acc10);
+		_mm_storeu_pd(out1 + i + 2, acc11);
+		_mm_storeu_pd(out2 + i, acc20);
+		_mm_storeu_pd(out2 + i + 2, acc21);
+	}
+#endif
+	// Scalar tail.
+	for (; i < n; ++ i) {
+		double acc1 = 0.;
+		double acc2 = 0.;
+		for (int m = 0; m < taps; ++ m) {
+			acc1 += in[i + m] * coef1[m];
+			acc2 += in[i + m] * coef2[m];
+		}
+		out1[i] = acc1;
+		out2[i] = acc2;
+	}
+}
+
+// Dot product of two contiguous vectors: sum_{m = 0}^{n - 1} a[m] * b[m].
+// Used where each output sample is filtered by a different coefficient set, as the phases
+// of a polyphase resampler. Each SIMD lane sums every fourth (eighth) product, the lanes
+// are added up at the end.
+static inline double dot_product(const double *a, const double *b, int n)
+{
+	double acc = 0.;
+	int m = 0;
+#if defined(__AVX2__)
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	for (; m + 8 <= n; m += 8) {
+	#ifdef __FMA__
+		acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + m), _mm256_loadu_pd(b + m), acc0);
+		acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + m + 4), _mm256_loadu_pd(b + m + 4), acc1);
+	#else
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + m), _mm256_loadu_pd(b + m)));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + m + 4), _mm256_loadu_pd(b + m + 4)));
+	#endif
+	}
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(_mm256_add_pd(acc0, acc1)), _mm256_extractf128_pd(_mm256_add_pd(acc0, acc1), 1));
+	acc = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+#elif defined(__SSE2__)
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	for (; m + 4 <= n; m += 4) {
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + m), _mm_loadu_pd(b + m)));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + m + 2), _mm_loadu_pd(b + m + 2)));
+	}
+	__m128d s = _mm_add_pd(acc0, acc1);
+	acc = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+#endif
+	// Scalar tail.
+	for (; m < n; ++ m)
+		acc += a[m] * b[m];
+	return acc;
+}
+
+// Single precision variants of the kernels above, twice as many samples per SIMD register.
+static inline void fir_block(const float *in, const float *coef, int taps, float *out, int n)
+{
+	int i = 0;
+#if defined(__AVX2__)
+	for (; i + 16 <= n; i += 16) {
+		__m256 acc0 = _mm256_setzero_ps();
+		__m256 acc1 = _mm256_setzero_ps();
+		const float *p = in + i;
+		for (int m = 0; m < taps; ++ m, ++ p) {
+			__m256 c = _mm256_broadcast_ss(coef + m);
+		#ifdef __FMA__
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(p), c, acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(p + 8), c, acc1);
+		#else
+			acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(p), c));
+			acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(p + 8), c));
+		#endif
+		}
+		_mm256_storeu_ps(out + i, acc0);
+		_mm256_storeu_ps(out + i + 8, acc1);
+	}
+#elif defined(__SSE2__)
+	for (; i + 8 <= n; i += 8) {
+		__m128 acc0 = _mm_setzero_ps();
+		__m128 acc1 = _mm_setzero_ps();
+		const float *p = in + i;
+		for (int m = 0; m < taps; ++ m, ++ p) {
+			__m128 c = _mm_set1_ps(coef[m]);
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(p), c));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(p + 4), c));
+		}
+		_mm_storeu_ps(out + i, acc0);
+		_mm_storeu_ps(out + i + 4, acc1);
+	}
+#endif
+	// Scalar tail.
+	for (; i < n; ++ i) {
+		float acc = 0.f;
+		for (int m = 0; m < taps; ++ m)
+			acc += in[i + m] * coef[m];
+		out[i] = acc;
+	}
+}
+
+static inline void fir_block2(const float *in, const float *coef1, const float *coef2, int taps, float *out1, float *out2, int n)
+{
+	int i = 0;
+#if defined(__AVX2__)
+	for (; i + 16 <= n; i += 16) {
+		__m256 acc10 = _mm256_setzero_ps();
+		__m256 acc11 = _mm256_setzero_ps();
+		__m256 acc20 = _mm256_setzero_ps();
+		__m256 acc21 = _mm256_setzero_ps();
+		const float *p = in + i;
+		for (int m = 0; m < taps; ++ m, ++ p) {
+			__m256 x0 = _mm256_loadu_ps(p);
+			__m256 x1 = _mm256_loadu_ps(p + 8);
+			__m256 c1 = _mm256_broadcast_ss(coef1 + m);
+			__m256 c2 = _mm256_broadcast_ss(coef2 + m);
+		#ifdef __FMA__
+			acc10 = _mm256_fmadd_ps(x0, c1, acc10);
+			acc11 = _mm256_fmadd_ps(x1, c1, acc11);
+			acc20 = _mm256_fmadd_ps(x0, c2, acc20);
+			acc21 = _mm256_fmadd_ps(x1, c2, acc21);
+		#else
+			acc10 = _mm256_add_ps(acc10, _mm256_mul_ps(x0, c1));
+			acc11 = _mm256_add_ps(acc11, _mm256_mul_ps(x1, c1));
+			acc20 = _mm256_add_ps(acc20, _mm256_mul_ps(x0, c2));
+			acc21 = _mm256_add_ps(acc21, _mm256_mul_ps(x1, c2));
+		#endif
+		}
+		_mm256_storeu_ps(out1 + i, acc10);
+		_mm256_storeu_ps(out1 + i + 8, acc11);
+		_mm256_storeu_ps(out2 + i, acc20);
+		_mm256_storeu_ps(out2 + i + 8, acc21);
+	}
+#elif defined(__SSE2__)
+	for (; i + 8 <= n; i += 8) {
+		__m128 acc10 = _mm_setzero_ps();
+		__m128 acc11 = _mm_setzero_ps();
+		__m128 acc20 = _mm_setzero_ps();
+		__m128 acc21 = _mm_setzero_ps();
+		const float *p = in + i;
+		for (int m = 0; m < taps; ++ m, ++ p) {
+			__m128 x0 = _mm_loadu_ps(p);
+			__m128 x1 = _mm_loadu_ps(p + 4);
+			__m128 c1 = _mm_set1_ps(coef1[m]);
+			__m128 c2 = _mm_set1_ps(coef2[m]);
+			acc10 = _mm_add_ps(acc10, _mm_mul_ps(x0, c1));
+			acc11 = _mm_add_ps(acc11, _mm_mul_ps(x1, c1));
+			acc20 = _mm_add_ps(acc20, _mm_mul_ps(x0, c2));
+			acc21 = _mm_add_ps(acc21, _mm_mul_ps(x1, c2));
+		}
+		_mm_storeu_ps(out1 + i, acc10);
+		_mm_storeu_ps(out1 + i + 4, acc11);
+		_mm_storeu_ps(out2 + i, acc20);
+		_mm_storeu_ps(out2 + i + 4, acc21);
+	}
+#endif
+	// Scalar tail.
+	for (; i < n; ++ i) {
+		float acc1 = 0.f;
+		float acc2 = 0.f;
+		for (int m = 0; m < taps; ++ m) {
+			acc1 += in[i + m] * coef1[m];
+			acc2 += in[i + m] * coef2[m];
+		}
+		out1[i] = acc1;
+		out2[i] = acc2;
+	}
+}
+
+static inline float dot_product(const float *a, const float *b, int n)
+{
+	float acc = 0.f;
+	int m = 0;
+#if defined(__AVX2__)
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+	for (; m + 16 <= n; m += 16) {
+	#ifdef __FMA__
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + m), _mm256_loadu_ps(b + m), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + m + 8), _mm256_loadu_ps(b + m + 8), acc1);
+	#else
+		acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + m), _mm256_loadu_ps(b + m)));
+		acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + m + 8), _mm256_loadu_ps(b + m + 8)));
+	#endif
+	}
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(_mm256_add_ps(acc0, acc1)), _mm256_extractf128_ps(_mm256_add_ps(acc0, acc1), 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	acc = _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+#elif defined(__SSE2__)
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for (; m + 8 <= n; m += 8) {
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + m), _mm_loadu_ps(b + m)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + m + 4), _mm_loadu_ps(b + m + 4)));
+	}
+	__m128 s = _mm_add_ps(acc0, acc1);
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	acc = _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+#endif
+	// Scalar tail.
+	for (; m < n; ++ m)
+		acc += a[m] * b[m];
+	return acc;
+}
+
+} // namespace PathSim
+
+#endif // PATHSIM_SIMD_HPP
@@ -0,0 +1,71 @@
+// Lock free single producer, single consumer ring buffer.
+
+#ifndef PATHSIM_SPSC_QUEUE_HPP
+#define PATHSIM_SPSC_QUEUE_HPP
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+namespace PathSim {
+
+// Fixed capacity ring of items passed from one thread to another. The producer only writes m_tail,
+// the consumer only writes m_head, each publishing its slots by a release store, which the other side
+// reads by an acquire load. The indices run freely, the slot is the index modulo the capacity.
+template<typename T>
+class SpscQueue
+{
+public:
+	// Capacity is rounded up to a power of two. Not thread safe, call before the threads start.
+	void init(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+		m_slots.assign(size, T());
+		m_mask = size - 1;
+		m_head.store(0, std::memory_order_relaxed);
+		m_tail.store(0, std::memory_order_relaxed);
+	}
+
+	// Producer side, returns false if the queue is full.
+	bool push(const T &item)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+			return false;
+		m_slots[tail & m_mask] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, returns false if the queue is empty.
+	bool pop(T &item)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return false;
+		item = m_slots[head & m_mask];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Number of the queued items, exact on the consumer side, approximate on the other threads.
+	size_t size() const
+	{
+		// The head first: it never passes the tail loaded later.
+		const size_t head = m_head.load(std::memory_order_acquire);
+		return m_tail.load(std::memory_order_acquire) - head;
+	}
+
+private:
+	std::vector<T> 		m_slots;
+	size_t 				m_mask 		{ 0 };
+	// Consumer and producer indices on separate cache lines.
+	alignas(64) std::atomic<size_t> m_head { 0 };
+	alignas(64) std::atomic<size_t> m_tail { 0 };
+};
+
+} // namespace PathSim
+
+#endif // PATHSIM_SPSC_QUEUE_HPP
@@ -0,0 +1,275 @@
+// Streaming WAV reader and writer, a block of samples at a time.
+
+#include "WavStream.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace PathSim {
+
+static uint32_t le32(const uint8_t *p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24); }
+static uint16_t le16(const uint8_t *p) { return uint16_t(p[0] | (p[1] << 8)); }
+
+static void put_le32(uint8_t *p, uint32_t v) { p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); p[2] = uint8_t(v >> 16); p[3] = uint8_t(v >> 24); }
+static void put_le16(uint8_t *p, uint16_t v) { p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); }
+
+// Sizes of the headers written: RIFF, fmt and data chunk headers, the float one with the fact chunk,
+// and the offsets of the sizes patched.
+static constexpr int      WAV_HEADER_SIZE      = 44;
+static constexpr int      FLOAT_HEADER_SIZE    = 58;
+static constexpr int      RIFF_SIZE_OFFSET     = 4;
+static constexpr int      FACT_FRAMES_OFFSET   = 46;
+static constexpr uint64_t MAX_DATA_SIZE        = 0xFFFFFFFFull - (WAV_HEADER_SIZE - 8);
+
+// The mapped input read is released from the process this far behind the read position.
+static constexpr size_t   RELEASE_STEP         = 1 << 20;
+
+template<typename T>
+bool WavReader<T>::open(const std::string &path, std::string &error)
+{
+	m_file.open(path, std::ios::binary);
+	if (! m_file) {
+		error = "failed opening " + path;
+		return false;
+	}
+	m_file.seekg(0, std::ios::end);
+	const uint64_t file_size = uint64_t(m_file.tellg());
+	m_file.seekg(0);
+
+	uint8_t header[12];
+	if (! m_file.read(reinterpret_cast<char*>(header), sizeof(header)) || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+		error = path + " is not a WAV file";
+		return false;
+	}
+	// Walk the chunks up to the data chunk, the format chunk is expected before it.
+	bool has_format = false;
+	uint16_t format = 0, block_align = 0;
+	uint32_t bytes_per_second = 0;
+	for (;;) {
+		uint8_t chunk[8];
+		if (! m_file.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+			error = path + ": data chunk not found";
+			return false;
+		}
+		const uint32_t size = le32(chunk + 4);
+		if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+			uint8_t fmt[16];
+			if (! m_file.read(reinterpret_cast<char*>(fmt), sizeof(fmt)))
+				break;
+			format           = le16(fmt);
+			m_channels       = le16(fmt + 2);
+			m_sample_rate    = le32(fmt + 4);
+			bytes_per_second = le32(fmt + 8);
+			block_align      = le16(fmt + 12);
+			m_bit_depth      = le16(fmt + 14);
+			has_format       = true;
+			m_file.seekg(std::streamoff(size - 16 + (size & 1)), std::ios::cur);
+		} else if (memcmp(chunk, "data", 4) == 0) {
+			if (! has_format) {
+				error = path + ": format chunk not found before the data chunk";
+				return false;
+			}
+			const uint64_t available = file_size - std::min<uint64_t>(file_size, uint64_t(m_file.tellg()));
+			// PCM or IEEE float.
+			if (format != 1 && format != 3) {
+				error = path + ": only PCM and float WAV files are supported";
+				return false;
+			}
+			m_float = format == 3;
+			if (m_channels < 1 || m_channels > 2) {
+				error = path + ": only mono and stereo WAV files are supported";
+				return false;
+			}
+			if (bytes_per_second != uint32_t(m_channels) * m_sample_rate * uint32_t(m_bit_depth) / 8 || block_align != m_channels * (m_bit_depth / 8)) {
+				error = path + ": inconsistent header";
+				return false;
+			}
+			if (m_float ? m_bit_depth != 32 : (m_bit_depth != 8 && m_bit_depth != 16 && m_bit_depth != 24)) {
+				error = path + ": only 8, 16 and 24 bit PCM and 32 bit float WAV files are supported";
+				return false;
+			}
+			m_frames    = size_t(std::min<uint64_t>(size, available) / block_align);
+			m_remaining = m_frames;
+			m_offset    = size_t(m_file.tellg());
+			this->map(path);
+			return true;
+		} else
+			m_file.seekg(std::streamoff(size) + (size & 1), std::ios::cur);
+	}
+	error = path + ": truncated header";
+	return false;
+}
+
+template<typename T>
+bool WavReader<T>::open_raw(const std::string &path, uint32_t sample_rate, std::string &error)
+{
+	m_file.open(path, std::ios::binary | std::ios::ate);
+	if (! m_file) {
+		error = "failed opening " + path;
+		return false;
+	}
+	m_sample_rate = sample_rate;
+	m_channels    = 1;
+	m_bit_depth   = 16;
+	m_frames      = size_t(m_file.tellg()) / 2;
+	m_remaining   = m_frames;
+	m_offset      = 0;
+	m_file.seekg(0);
+	this->map(path);
+	return true;
+}
+
+template<typename T>
+void WavReader<T>::map(const std::string &path)
+{
+	// Stay with the stream if the file cannot be mapped or was cut short since it was opened.
+	if (m_map.open(path) && m_map.size() >= m_offset + m_frames * size_t(m_channels * (m_bit_depth / 8)))
+		m_file.close();
+	else
+		m_map.close();
+}
+
+template<typename T>
+size_t WavReader<T>::read(T *out, size_t n)
+{
+	const int frame_size = m_channels * (m_bit_depth / 8);
+	n = std::min(n, m_remaining);
+	const uint8_t *p;
+	if (this->mapped()) {
+		p = m_map.data() + m_offset;
+		// The pages of the previous blocks are done with.
+		if (m_offset >= RELEASE_STEP)
+			m_map.release(m_offset - RELEASE_STEP);
+		m_offset    += n * frame_size;
+		m_remaining -= n;
+	} else {
+		m_bytes.resize(n * frame_size);
+		m_file.read(reinterpret_cast<char*>(m_bytes.data()), std::streamsize(m_bytes.size()));
+		n = size_t(m_file.gcount()) / frame_size;
+		m_remaining = m_file ? m_remaining - n : 0;
+		p = m_bytes.data();
+	}
+	// The same conversions as of AudioFile::decodeWaveFile().
+	switch (this->sample_format()) {
+	case SampleFormat::PCM8: 	decode_pcm8   (p, frame_size, out, n); break;
+	case SampleFormat::PCM16: 	decode_pcm16  (p, frame_size, out, n); break;
+	case SampleFormat::PCM24: 	decode_pcm24  (p, frame_size, out, n); break;
+	case SampleFormat::FLOAT32: decode_float32(p, frame_size, out, n); break;
+	}
+	return n;
+}
+
+template<typename T>
+bool WavWriter<T>::open(const std::string &path, uint32_t sample_rate, int channels, SampleFormat input_format, const OutputFormat &format)
+{
+	this->close();
+	m_channels    = channels;
+	m_format      = format.same_as_input ? input_format : format.sample_format;
+	m_sample_size = m_format == SampleFormat::PCM8 ? 1 : m_format == SampleFormat::PCM16 ? 2 : m_format == SampleFormat::PCM24 ? 3 : 4;
+	m_raw         = format.raw;
+	m_dither      = format.dither && (m_format == SampleFormat::PCM16 || m_format == SampleFormat::PCM24);
+	m_tpdf.init(format.dither_seed);
+	m_data_size   = 0;
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	m_ok = bool(m_file);
+	if (m_raw || ! m_ok) {
+		m_header_size = 0;
+		return m_ok;
+	}
+	const bool is_float = m_format == SampleFormat::FLOAT32;
+	// PCM: RIFF, 16 byte fmt and data chunk headers. Float: 18 byte fmt chunk, fact chunk holding the frames.
+	m_header_size      = is_float ? FLOAT_HEADER_SIZE : WAV_HEADER_SIZE;
+	m_data_size_offset = m_header_size - 4;
+	uint8_t header[FLOAT_HEADER_SIZE];
+	uint8_t *p = header;
+	memcpy(p, "RIFF", 4);
+	put_le32(p + RIFF_SIZE_OFFSET, uint32_t(m_header_size - 8));
+	memcpy(p + 8, "WAVEfmt ", 8);
+	put_le32(p + 16, is_float ? 18 : 16);
+	put_le16(p + 20, is_float ? 3 : 1);
+	put_le16(p + 22, uint16_t(channels));
+	put_le32(p + 24, sample_rate);
+	put_le32(p + 28, uint32_t(channels) * sample_rate * uint32_t(m_sample_size));
+	put_le16(p + 32, uint16_t(channels * m_sample_size));
+	put_le16(p + 34, uint16_t(m_sample_size * 8));
+	p += 36;
+	if (is_float) {
+		put_le16(p, 0);
+		memcpy(p + 2, "fact", 4);
+		put_le32(p + 6, 4);
+		put_le32(p + 10, 0);
+		p += 14;
+	}
+	memcpy(p, "data", 4);
+	put_le32(p + 4, 0);
+	m_file.write(reinterpret_cast<const char*>(header), m_header_size);
+	m_ok = bool(m_file);
+	return m_ok;
+}
+
+template<typename T>
+bool WavWriter<T>::write(const T *in, size_t n)
+{
+	if (! m_ok)
+		return false;
+	const int frame_size = m_channels * m_sample_size;
+	// A single channel is encoded straight into the output buffer.
+	std::vector<uint8_t> &mono = m_channels == 1 ? m_bytes : m_mono;
+	mono.resize(n * m_sample_size);
+	const double *dither = nullptr;
+	if (m_dither) {
+		m_dither_values.resize(n);
+		m_tpdf.generate(m_dither_values.data(), n);
+		dither = m_dither_values.data();
+	}
+	switch (m_format) {
+	case SampleFormat::PCM8: 	encode_pcm8   (in, mono.data(), n); break;
+	case SampleFormat::PCM16: 	encode_pcm16  (in, dither, mono.data(), n); break;
+	case SampleFormat::PCM24: 	encode_pcm24  (in, dither, mono.data(), n); break;
+	case SampleFormat::FLOAT32: encode_float32(in, mono.data(), n); break;
+	}
+	if (m_channels > 1) {
+		m_bytes.resize(n * frame_size);
+		const uint8_t *src = mono.data();
+		uint8_t       *dst = m_bytes.data();
+		for (size_t i = 0; i < n; ++ i, src += m_sample_size)
+			for (int k = 0; k < m_channels; ++ k, dst += m_sample_size)
+				memcpy(dst, src, m_sample_size);
+	}
+	m_file.write(reinterpret_cast<const char*>(m_bytes.data()), std::streamsize(n * frame_size));
+	m_data_size += uint64_t(n) * frame_size;
+	m_ok = bool(m_file) && (m_raw || m_data_size <= MAX_DATA_SIZE - (m_header_size - WAV_HEADER_SIZE));
+	return m_ok;
+}
+
+template<typename T>
+bool WavWriter<T>::close()
+{
+	if (! m_file.is_open())
+		return m_ok;
+	if (m_ok && m_header_size > 0) {
+		uint8_t size[4];
+		put_le32(size, uint32_t(m_data_size + m_header_size - 8));
+		m_file.seekp(RIFF_SIZE_OFFSET);
+		m_file.write(reinterpret_cast<const char*>(size), sizeof(size));
+		if (m_format == SampleFormat::FLOAT32) {
+			put_le32(size, uint32_t(m_data_size / uint64_t(m_channels * m_sample_size)));
+			m_file.seekp(FACT_FRAMES_OFFSET);
+			m_file.write(reinterpret_cast<const char*>(size), sizeof(size));
+		}
+		put_le32(size, uint32_t(m_data_size));
+		m_file.seekp(m_data_size_offset);
+		m_file.write(reinterpret_cast<const char*>(size), sizeof(size));
+		m_ok = bool(m_file);
+	}
+	m_file.close();
+	m_ok = m_ok && ! m_file.fail();
+	return m_ok;
+}
+
+template class WavReader<float>;
+template class WavReader<double>;
+template class WavWriter<float>;
+template class WavWriter<double>;
+
+} // namespace PathSim
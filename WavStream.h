@@ -0,0 +1,134 @@
+// Streaming WAV reader and writer, a block of samples at a time.
+
+#ifndef PATHSIM_WAV_STREAM_HPP
+#define PATHSIM_WAV_STREAM_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Pcm.h"
+
+namespace PathSim {
+
+enum class SampleFormat {
+	PCM8,
+	PCM16,
+	PCM24,
+	FLOAT32,
+};
+
+// PCM format of the bit depth, 8, 16 or 24.
+inline SampleFormat pcm_format(int bit_depth)
+{
+	return bit_depth == 8 ? SampleFormat::PCM8 : bit_depth == 24 ? SampleFormat::PCM24 : SampleFormat::PCM16;
+}
+
+// Encoding of the output files.
+struct OutputFormat
+{
+	// Sample format of the output, the format of the input if not set.
+	bool 			same_as_input 	{ true };
+	SampleFormat 	sample_format 	{ SampleFormat::PCM16 };
+	// Samples only, without the WAV header.
+	bool 			raw 			{ false };
+	// TPDF dither of the 16 and 24 bit samples, which are then rounded instead of truncated.
+	bool 			dither 			{ false };
+	uint64_t 		dither_seed 	{ 0 };
+};
+
+// Reads the PCM samples of a WAV file in blocks, so that the memory used does not depend on the length
+// of the file. Accepts the files AudioFile accepts: 8, 16 or 24 bit PCM, mono or stereo, and decodes
+// the samples the same way, and 32 bit float files. The file is memory mapped if possible, see MappedFile, and the samples are
+// decoded straight from the mapping, otherwise the blocks are read into a buffer.
+template<typename T>
+class WavReader
+{
+public:
+	// Parse the header. Returns false with a message if the file is not a WAV file of a supported format.
+	bool 		open(const std::string &path, std::string &error);
+	// Open a file of headerless 16 bit little endian mono samples.
+	bool 		open_raw(const std::string &path, uint32_t sample_rate, std::string &error);
+
+	uint32_t 	sample_rate() const { return m_sample_rate; }
+	int 		channels()    const { return m_channels; }
+	int 		bit_depth()   const { return m_bit_depth; }
+	SampleFormat sample_format() const { return m_float ? SampleFormat::FLOAT32 : pcm_format(m_bit_depth); }
+	// Frames of the file, as declared by the data chunk and limited by the length of the file.
+	size_t 		frames()      const { return m_frames; }
+
+	// Decode up to n frames of the first channel, returns the number of the frames read, 0 at the end.
+	size_t 		read(T *out, size_t n);
+
+	// Whether the samples are read from a memory mapping.
+	bool 		mapped()      const { return m_map.data() != nullptr; }
+
+private:
+	// Map the file if possible, the samples start at m_offset.
+	void 		map(const std::string &path);
+
+	std::ifstream 			m_file;
+	MappedFile 				m_map;
+	// Offset of the next frame in the mapping.
+	size_t 					m_offset 		{ 0 };
+	uint32_t 				m_sample_rate 	{ 0 };
+	int 					m_channels 		{ 0 };
+	int 					m_bit_depth 	{ 0 };
+	bool 					m_float 		{ false };
+	size_t 					m_frames 		{ 0 };
+	// Frames not read yet.
+	size_t 					m_remaining 	{ 0 };
+	std::vector<uint8_t> 	m_bytes;
+};
+
+// Writes a WAV file in blocks. The header is written first with the sizes left empty,
+// close() patches the sizes of the RIFF and data chunks once the length is known.
+// The samples are encoded by the kernels of Pcm.h, without dither the same way as by AudioFile::save().
+// The float files carry the fact chunk required of the formats other than PCM.
+template<typename T>
+class WavWriter
+{
+public:
+	~WavWriter() { this->close(); }
+
+	// input_format: format of the input file, written if format.same_as_input.
+	bool 		open(const std::string &path, uint32_t sample_rate, int channels, SampleFormat input_format, const OutputFormat &format = OutputFormat());
+	// Encode n samples into all the channels.
+	bool 		write(const T *in, size_t n);
+	// Patch the header and close the file. Returns false if any write failed.
+	bool 		close();
+
+private:
+	std::ofstream 			m_file;
+	int 					m_channels 		{ 0 };
+	SampleFormat 			m_format 		{ SampleFormat::PCM16 };
+	int 					m_sample_size 	{ 2 };
+	bool 					m_raw 			{ false };
+	bool 					m_dither 		{ false };
+	TpdfDither 				m_tpdf;
+	// Offsets of the sizes patched by close(), by the format of the header.
+	int 					m_header_size 	{ 0 };
+	int 					m_data_size_offset { 0 };
+	uint64_t 				m_data_size 	{ 0 };
+	bool 					m_ok 			{ false };
+	// A block encoded for the first channel, then interleaved into all of them.
+	std::vector<uint8_t> 	m_mono;
+	std::vector<uint8_t> 	m_bytes;
+	std::vector<double> 	m_dither_values;
+};
+
+// Write n samples into all the channels of a new file.
+template<typename T>
+bool write_wav_file(const std::string &path, const T *samples, size_t n, uint32_t sample_rate, int channels,
+	SampleFormat input_format, const OutputFormat &format)
+{
+	WavWriter<T> writer;
+	return writer.open(path, sample_rate, channels, input_format, format) && writer.write(samples, n) && writer.close();
+}
+
+} // namespace PathSim
+
+#endif // PATHSIM_WAV_STREAM_HPP
@@ -0,0 +1,78 @@
+// Persistent pool of worker threads running batches of independent tasks.
+
+#include "WorkerPool.h"
+
+namespace PathSim {
+
+void WorkerPool::start(int threads)
+{
+	this->stop();
+	m_stop = false;
+	for (int i = 1; i < threads; ++ i)
+		m_workers.emplace_back(&WorkerPool::worker, this, m_generation);
+}
+
+void WorkerPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_start.notify_all();
+	for (std::thread &t : m_workers)
+		t.join();
+	m_workers.clear();
+}
+
+void WorkerPool::run(Task task, void *context, int ntasks)
+{
+	if (m_workers.empty() || ntasks <= 1) {
+		for (int i = 0; i < ntasks; ++ i)
+			task(context, i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task    = task;
+		m_context = context;
+		m_ntasks  = ntasks;
+		m_pending = int(m_workers.size());
+		m_next    = 0;
+		++ m_generation;
+	}
+	m_start.notify_all();
+	this->run_tasks(task, context, ntasks);
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this]{ return m_pending == 0; });
+}
+
+void WorkerPool::run_tasks(Task task, void *context, int ntasks)
+{
+	for (int i; (i = m_next.fetch_add(1)) < ntasks;)
+		task(context, i);
+}
+
+void WorkerPool::worker(unsigned generation)
+{
+	for (;;) {
+		Task  task;
+		void *context;
+		int   ntasks;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock, [this, generation]{ return m_stop || m_generation != generation; });
+			if (m_stop)
+				return;
+			generation = m_generation;
+			task       = m_task;
+			context    = m_context;
+			ntasks     = m_ntasks;
+		}
+		this->run_tasks(task, context, ntasks);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (-- m_pending == 0)
+			m_done.notify_one();
+	}
+}
+
+} // namespace PathSim
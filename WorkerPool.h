@@ -0,0 +1,93 @@
+// Persistent pool of worker threads running batches of independent tasks.
+
+#ifndef PATHSIM_WORKER_POOL_HPP
+#define PATHSIM_WORKER_POOL_HPP
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PathSim {
+
+// The workers are started once and sleep between the batches. A batch is described by a plain
+// function pointer and a context pointer, so that running it allocates nothing.
+class WorkerPool
+{
+public:
+	typedef void (*Task)(void *context, int index);
+
+	WorkerPool() {}
+	~WorkerPool() { this->stop(); }
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Start threads - 1 workers, the thread calling run() is the last one. threads <= 1 runs the tasks serially.
+	void start(int threads);
+	void stop();
+	// Number of threads running a batch, including the calling one.
+	int  threads() const { return int(m_workers.size()) + 1; }
+
+	// Run task(context, i) for i = 0 .. ntasks - 1 on the workers and on the calling thread,
+	// return once all of them finished. Each index is run exactly once, by whichever thread takes it first,
+	// thus the tasks have to be independent of each other for the result not to depend on the scheduling.
+	void run(Task task, void *context, int ntasks);
+
+private:
+	// generation: of the last batch before the worker was started.
+	void worker(unsigned generation);
+	// Take and run the tasks of the current batch until none is left.
+	void run_tasks(Task task, void *context, int ntasks);
+
+	std::vector<std::thread>    m_workers;
+	std::mutex                  m_mutex;
+	// Signals the workers a new batch or the stop, and the caller the end of a batch.
+	std::condition_variable     m_start;
+	std::condition_variable     m_done;
+	// Incremented for each batch, the workers wait for a change.
+	unsigned                    m_generation    { 0 };
+	bool                        m_stop          { false };
+	// The batch, read by the workers under the lock when they wake up.
+	Task                        m_task          { nullptr };
+	void                       *m_context       { nullptr };
+	int                         m_ntasks        { 0 };
+	// Workers which have not left the current batch yet. run() returns when all of them did,
+	// so that no worker is left taking tasks when the next batch resets m_next.
+	int                         m_pending       { 0 };
+	// Next task index to be taken.
+	std::atomic<int>            m_next          { 0 };
+};
+
+// Run run_job(i, worker) for the jobs i = 0 .. njobs - 1 on a pool of threads. Each thread owns
+// a default constructed Worker, the state reused for all the jobs the thread runs, and takes
+// the next job until none is left, so that jobs of unequal length balance over the threads.
+template<typename Worker, typename RunJob>
+void run_job_queue(size_t njobs, int threads, const RunJob &run_job)
+{
+	struct Context {
+		const RunJob                            *run_job;
+		size_t                                   njobs;
+		std::vector<std::unique_ptr<Worker>>     workers;
+		std::atomic<size_t>                      next       { 0 };
+	} ctx;
+	ctx.run_job = &run_job;
+	ctx.njobs   = njobs;
+	for (int i = 0; i < threads; ++ i)
+		ctx.workers.emplace_back(new Worker);
+	WorkerPool::Task task = [](void *context, int slot) {
+		Context &ctx    = *static_cast<Context*>(context);
+		Worker  &worker = *ctx.workers[slot];
+		for (size_t i; (i = ctx.next.fetch_add(1)) < ctx.njobs;)
+			(*ctx.run_job)(i, worker);
+	};
+	WorkerPool pool;
+	pool.start(threads);
+	pool.run(task, &ctx, threads);
+}
+
+} // namespace PathSim
+
+#endif // PATHSIM_WORKER_POOL_HPP
@@ -3,12 +3,13 @@
 
 namespace PathSim {
 
+template<typename T>
 struct cmplx {
-	double r { 0. };
-	double i { 0. };
+	T r { 0 };
+	T i { 0 };
 
-	void   set(double r, double i) { this->r = r; this->i = i; }
-	double l2() const { return r * r + i * i; }
+	void   set(T r, T i) { this->r = r; this->i = i; }
+	T      l2() const { return r * r + i * i; }
 
 	cmplx& operator+=(const cmplx &rhs) {
 		this->r += rhs.r;
@@ -16,24 +17,41 @@ struct cmplx {
 		return *this;
 	}
 
-	cmplx& operator*=(const double rhs) {
+	cmplx& operator*=(const T rhs) {
 		this->r *= rhs;
 		this->i *= rhs;
 		return *this;
 	}
 };
 
-static inline cmplx operator*(const cmplx &lhs, const cmplx &rhs)
+// Block of complex samples stored as separate planes of the real and imaginary parts,
+// so that the block kernels load either plane with plain vector loads, without shuffles.
+// It is a view, the planes are owned by an Arena or by the processing object.
+template<typename T>
+struct cmplx_block {
+	T *r { nullptr };
+	T *i { nullptr };
+
+	cmplx_block() = default;
+	cmplx_block(T *r, T *i) : r(r), i(i) {}
+	// cmplx_block<T> converts to cmplx_block<const T>.
+	template<typename U>
+	cmplx_block(const cmplx_block<U> &rhs) : r(rhs.r), i(rhs.i) {}
+};
+
+template<typename T>
+static inline cmplx<T> operator*(const cmplx<T> &lhs, const cmplx<T> &rhs)
 {
-	return cmplx{
+	return cmplx<T>{
         lhs.r * rhs.r - lhs.i * rhs.i,
         lhs.r * rhs.i + lhs.i * rhs.r
     };
 }
 
-static inline cmplx operator*(const cmplx &lhs, const double rhs)
+template<typename T>
+static inline cmplx<T> operator*(const cmplx<T> &lhs, const T rhs)
 {
-	return cmplx{ lhs.r * rhs, lhs.i * rhs };
+	return cmplx<T>{ lhs.r * rhs, lhs.i * rhs };
 }
 
 } // namespace PathSim
@@ -1,12 +1,401 @@
 #include "PathSimProcessor.h"
 #include "PathSimParams.h"
+#include "FilterDesign.h"
+#include "Pipeline.h"
+#include "Benchmark.h"
+#include "Batch.h"
+#include "Profiles.h"
+#include "WavStream.h"
 
+#include <math.h>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include "cxxopts.h"
 #include "AudioFile.h"
 
 using namespace PathSim;
 
+// The processing chain is designed for the sample rate of the input file, within the supported range.
+static bool check_sample_rate(double sample_rate)
+{
+    if (sample_rate < PathSimProcessor<double>::MIN_SAMPLE_RATE || sample_rate > PathSimProcessor<double>::MAX_SAMPLE_RATE) {
+        std::cout << "unsupported sample rate " << sample_rate << " Hz, supported are " << PathSimProcessor<double>::MIN_SAMPLE_RATE
+            << " to " << PathSimProcessor<double>::MAX_SAMPLE_RATE << " Hz" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// How the file is processed: in blocks in place, or streamed at 8 kHz with the input and the output
+// resampled, or streamed through the pipelined stages.
+enum ProcessingMode {
+    PROCESS_BLOCKS,
+    PROCESS_RESAMPLED,
+    PROCESS_PIPELINED,
+};
+
+// Stream the samples through the processor, then drop the delay of the streaming, so that the output
+// is aligned with the input the same way as when processing in blocks.
+template<typename Processor, typename T>
+static void stream(Processor &processor, std::vector<T> &samples, int delay)
+{
+    const size_t len = samples.size();
+    samples.resize(len + delay, T(0));
+    processor.process(samples.data(), samples.data(), samples.size());
+    samples.erase(samples.begin(), samples.begin() + delay);
+}
+
+// Samples read, processed and written at a time when streaming a WAV file.
+static constexpr size_t STREAM_CHUNK = 4096;
+
+// Stream the input file through the processor into the output file a chunk at a time. The input is followed
+// by delay zeros and the first delay samples of the output are dropped, so that the output is aligned with
+// the input the same way as by stream().
+template<typename Processor, typename T>
+static bool stream_file(Processor &processor, int delay, WavReader<T> &reader, WavWriter<T> &writer)
+{
+    std::vector<T> chunk(STREAM_CHUNK);
+    size_t skip = size_t(delay);
+    size_t tail = size_t(delay);
+    for (;;) {
+        size_t n = reader.read(chunk.data(), chunk.size());
+        if (n == 0) {
+            if (tail == 0)
+                break;
+            n = std::min(tail, chunk.size());
+            std::fill(chunk.begin(), chunk.begin() + n, T(0));
+            tail -= n;
+        }
+        processor.process(chunk.data(), chunk.data(), n);
+        const size_t drop = std::min(skip, n);
+        skip -= drop;
+        if (! writer.write(chunk.data() + drop, n - drop))
+            return false;
+    }
+    return writer.close();
+}
+
+// Run the simulation on a WAV file a chunk at a time, the memory used does not depend on the length of the file.
+// The input is decoded straight from its memory mapping where possible. The output is the same as of simulate().
+// raw_rate > 0: the input is raw 16 bit mono at this sample rate. Returns -1 if the input is not a WAV file
+// simulate() could read.
+template<typename T>
+static int simulate_streaming(const PathSimParams &params, ProcessingMode mode, uint32_t raw_rate, const OutputFormat &format,
+    const std::string &input_file, const std::string &output_file)
+{
+    WavReader<T> reader;
+    std::string  error;
+    if (raw_rate > 0 ? ! reader.open_raw(input_file, raw_rate, error) : ! reader.open(input_file, error)) {
+        if (raw_rate == 0)
+            return -1;
+        std::cout << "failed loading input file: " << input_file << std::endl;
+        return 1;
+    }
+    if (! check_sample_rate(reader.sample_rate()))
+        return 1;
+    WavWriter<T> writer;
+    if (! writer.open(output_file, reader.sample_rate(), reader.channels(), reader.sample_format(), format))
+        return 1;
+    bool ok;
+    if (mode == PROCESS_RESAMPLED) {
+        ResamplingProcessor<T> processor;
+        processor.init(params, reader.sample_rate());
+        ok = stream_file(processor, processor.resampling_delay(), reader, writer);
+    } else if (mode == PROCESS_PIPELINED) {
+        PipelinedProcessor<T> processor;
+        processor.init(params, reader.sample_rate());
+        ok = stream_file(processor, processor.pipeline_delay(), reader, writer);
+    } else {
+        // Collecting the blocks delays the output by a block, the last block is completed by zeros.
+        PathSimProcessor<T> processor;
+        processor.init(params, reader.sample_rate());
+        ok = stream_file(processor, processor.block_size(), reader, writer);
+    }
+    return ok ? 0 : 1;
+}
+
+// Run the simulation with the processing chain instantiated for double or float samples.
+template<typename T>
+static int simulate(const PathSimParams &params, ProcessingMode mode, const OutputFormat &format, const std::string &input_file, const std::string &output_file)
+{
+    AudioFile<T> audio_file;
+    bool loaded  = audio_file.load(input_file);
+    if (! loaded) {
+        std::cout << "failed loading input file: " << input_file << std::endl;
+        return 1;
+    }
+    if (! check_sample_rate(audio_file.getSampleRate()))
+        return 1;
+    int  len     = audio_file.getNumSamplesPerChannel();
+    if (mode == PROCESS_RESAMPLED) {
+        ResamplingProcessor<T> processor;
+        processor.init(params, audio_file.getSampleRate());
+        stream(processor, audio_file.samples.front(), processor.resampling_delay());
+    } else if (mode == PROCESS_PIPELINED) {
+        PipelinedProcessor<T> processor;
+        processor.init(params, audio_file.getSampleRate());
+        stream(processor, audio_file.samples.front(), processor.pipeline_delay());
+    } else {
+        PathSimProcessor<T> processor;
+        processor.init(params, audio_file.getSampleRate());
+        int  bufsize = processor.block_size();
+        int  nblocks = (len + bufsize - 1) / bufsize;
+        audio_file.samples.front().resize(size_t(bufsize) * nblocks, T(0));
+        for (int i = 0; i < nblocks; ++ i)
+            processor.process_buffer(audio_file.samples.front().data() + size_t(i) * bufsize);
+    }
+    return write_wav_file(output_file, audio_file.samples.front().data(), size_t(len), audio_file.getSampleRate(),
+        audio_file.getNumChannels(), pcm_format(audio_file.getBitDepth()), format) ? 0 : 1;
+}
+
+// Parse the SNRs of the sweep: a comma separated list of values in dB, or a range "from:to:step".
+static bool parse_snr_sweep(const std::string &spec, std::vector<double> &snrs)
+{
+    try {
+        size_t colon = spec.find(':');
+        if (colon != std::string::npos) {
+            size_t colon2 = spec.find(':', colon + 1);
+            if (colon2 == std::string::npos)
+                return false;
+            double from = std::stod(spec.substr(0, colon));
+            double to   = std::stod(spec.substr(colon + 1, colon2 - colon - 1));
+            double step = std::stod(spec.substr(colon2 + 1));
+            if (step == 0. || (to - from) / step < 0.)
+                return false;
+            int n = int(floor((to - from) / step + 1e-9)) + 1;
+            for (int i = 0; i < n; ++ i)
+                // Rounded, so that the accumulated error does not show in the file names.
+                snrs.emplace_back(floor((from + i * step) * 1e6 + 0.5) * 1e-6);
+        } else {
+            for (size_t start = 0; start <= spec.size();) {
+                size_t end = std::min(spec.find(',', start), spec.size());
+                snrs.emplace_back(std::stod(spec.substr(start, end - start)));
+                start = end + 1;
+            }
+        }
+    } catch (const std::exception &) {
+        return false;
+    }
+    return ! snrs.empty();
+}
+
+// Output file of a sweep or of a condition: the suffix inserted before the extension of output_file.
+static std::string suffixed_file(const std::string &output_file, const std::string &suffix)
+{
+    size_t dot = output_file.find_last_of('.');
+    size_t sep = output_file.find_last_of("/\\");
+    if (dot == std::string::npos || (sep != std::string::npos && dot < sep))
+        dot = output_file.size();
+    return output_file.substr(0, dot) + suffix + output_file.substr(dot);
+}
+
+// Output file of the sweep at the SNR: "_snr<SNR>" inserted before the extension of output_file.
+static std::string snr_sweep_file(const std::string &output_file, double snr)
+{
+    std::ostringstream suffix;
+    suffix << "_snr" << snr;
+    return suffixed_file(output_file, suffix.str());
+}
+
+// Run the simulation once up to the noise, then write an output file with the noise added at each SNR.
+template<typename T>
+static int simulate_snr_sweep(const PathSimParams &params, const std::vector<double> &snrs, const OutputFormat &format,
+    const std::string &input_file, const std::string &output_file)
+{
+    AudioFile<T> audio_file;
+    if (! audio_file.load(input_file)) {
+        std::cout << "failed loading input file: " << input_file << std::endl;
+        return 1;
+    }
+    if (! check_sample_rate(audio_file.getSampleRate()))
+        return 1;
+    PathSimParams sweep_params = params;
+    sweep_params.noise.has_awgn = false;
+    PathSimProcessor<T> processor;
+    processor.init(sweep_params, audio_file.getSampleRate());
+    const int    len     = audio_file.getNumSamplesPerChannel();
+    const int    bufsize = processor.block_size();
+    const int    nblocks = (len + bufsize - 1) / bufsize;
+    std::vector<T> &input = audio_file.samples.front();
+    input.resize(size_t(bufsize) * nblocks, T(0));
+    std::vector<std::vector<T>> outputs(snrs.size(), std::vector<T>(input.size(), T(0)));
+    std::vector<T*> blocks(snrs.size());
+    for (int i = 0; i < nblocks; ++ i) {
+        for (size_t k = 0; k < snrs.size(); ++ k)
+            blocks[k] = outputs[k].data() + size_t(i) * bufsize;
+        processor.process_buffer_snr_sweep(input.data() + size_t(i) * bufsize, snrs.data(), int(snrs.size()), blocks.data());
+    }
+    for (size_t k = 0; k < snrs.size(); ++ k)
+        if (! write_wav_file(snr_sweep_file(output_file, snrs[k]), outputs[k].data(), size_t(len), audio_file.getSampleRate(),
+                audio_file.getNumChannels(), pcm_format(audio_file.getBitDepth()), format))
+            return 1;
+    return 0;
+}
+
+// Measure the throughput of the double and float processing chains on the input file.
+static int benchmark(const PathSimParams &params, const std::string &input_file)
+{
+    AudioFile<double> audio_file;
+    if (! audio_file.load(input_file)) {
+        std::cout << "failed loading input file: " << input_file << std::endl;
+        return 1;
+    }
+    if (! check_sample_rate(audio_file.getSampleRate()))
+        return 1;
+    run_benchmark(params, audio_file.samples.front(), audio_file.getSampleRate(), std::cout);
+    return 0;
+}
+
+// Find the propagation condition by its command line name.
+static const PathSimParams* find_condition(const std::string &name)
+{
+    for (const PathSimParams &p : default_params())
+        if (p.cmdline_param == name)
+            return &p;
+    return nullptr;
+}
+
+// Apply the propagation and processing options of the command line to the parameters of a condition.
+static bool apply_options(const cxxopts::ParseResult &result, PathSimParams &params)
+{
+    if (result.count("snr"))
+        params.noise = { true, result["snr"].as<double>() };
+    if (result.count("filter-taps")) {
+        params.filter_taps = result["filter-taps"].as<int>();
+        if (params.filter_taps < MIN_CHANNEL_FILTER_TAPS) {
+            std::cerr << "pathsim: number of filter taps has to be at least " << MIN_CHANNEL_FILTER_TAPS << std::endl;
+            return false;
+        }
+    }
+    if (result.count("seed"))
+        params.seed = result["seed"].as<uint64_t>();
+    if (result.count("block-size")) {
+        params.block_size = result["block-size"].as<int>();
+        if (params.block_size < 1 || params.block_size > PathSimProcessor<double>::BUF_SIZE) {
+            std::cerr << "pathsim: block size has to be 1 to " << PathSimProcessor<double>::BUF_SIZE << std::endl;
+            return false;
+        }
+    }
+
+    if (result.count("threads")) {
+        params.threads = result["threads"].as<int>();
+        if (params.threads < 1) {
+            std::cerr << "pathsim: number of threads has to be at least 1" << std::endl;
+            return false;
+        }
+    }
+
+    for (int i = 0; i < 3; ++ i) {
+        // Options of the i-th path, the 1st path has no index suffix.
+        auto init_path = [i, &params]() -> PathParams& {
+            if (int(params.paths.size()) <= i)
+                params.paths.resize(i + 1);
+            return params.paths[i];
+        };
+        std::string sidx;
+        if (i > 0)
+            sidx = std::to_string(i + 1);
+        std::string delay = std::string("delay") + sidx;
+        if (i > 0 && result.count(delay))
+            init_path().delay = result[delay].as<double>();
+        std::string spread = std::string("spread") + sidx;
+        if (result.count(spread))
+            init_path().spread = result[spread].as<double>();
+        std::string offset = std::string("offset") + sidx;
+        if (result.count(offset))
+            init_path().offset = result[offset].as<double>();
+        std::string delay_rate = std::string("delay-rate") + sidx;
+        if (i > 0 && result.count(delay_rate))
+            init_path().delay_rate = result[delay_rate].as<double>();
+    }
+    return true;
+}
+
+// Simulate the propagation conditions listed, "all" for all of them, each into output_<condition>.wav,
+// or the condition of the command line if the list is empty. With realizations > 0 each condition is simulated
+// that many times, the i-th time with the seed increased by i, into output[_<condition>]_seed<seed>.wav.
+// The options of the command line apply to all the conditions, --threads sets the number of the simulations
+// running concurrently, all the CPUs by default. The outputs do not depend on the number of the threads.
+static int profiles(const cxxopts::ParseResult &result, const PathSimParams &params, const std::string &list, int realizations,
+    const OutputFormat &format, const std::string &input_file, const std::string &output_file)
+{
+    std::vector<ProfileJob> conditions;
+    if (list.empty())
+        conditions.push_back({ params, output_file });
+    for (size_t start = 0; start < list.size() + 1 && ! list.empty();) {
+        size_t end = std::min(list.find(',', start), list.size());
+        const std::string name = list.substr(start, end - start);
+        start = end + 1;
+        std::vector<const PathSimParams*> found;
+        if (name == "all")
+            for (const PathSimParams &p : default_params())
+                found.emplace_back(&p);
+        else if (const PathSimParams *condition = find_condition(name))
+            found.emplace_back(condition);
+        else {
+            std::cerr << "pathsim: unknown propagation condition " << name << std::endl;
+            return -1;
+        }
+        for (const PathSimParams *condition : found) {
+            ProfileJob job { *condition, suffixed_file(output_file, "_" + condition->cmdline_param) };
+            if (! apply_options(result, job.params))
+                return -1;
+            conditions.emplace_back(std::move(job));
+        }
+    }
+    std::vector<ProfileJob> jobs;
+    for (ProfileJob &condition : conditions) {
+        condition.params.threads = 0;
+        if (realizations == 0)
+            jobs.emplace_back(std::move(condition));
+        for (int i = 0; i < realizations; ++ i) {
+            ProfileJob job = condition;
+            job.params.seed += uint64_t(i);
+            job.output_file  = suffixed_file(condition.output_file, "_seed" + std::to_string(job.params.seed));
+            jobs.emplace_back(std::move(job));
+        }
+    }
+    int threads = result.count("threads") ? result["threads"].as<int>() : int(std::thread::hardware_concurrency());
+    return run_profiles(jobs, input_file, std::max(1, threads), result.count("float") > 0, format, std::cout) == 0 ? 0 : 1;
+}
+
+// Process the jobs of the manifest. A job without a propagation condition uses the one of the command line,
+// the other options of the command line apply to all the jobs. --threads sets the number of the jobs processed
+// concurrently, all the CPUs by default, each job is processed by a single thread.
+static int batch(const cxxopts::ParseResult &result, const PathSimParams &params, const OutputFormat &format, const std::string &manifest)
+{
+    std::vector<BatchEntry> entries;
+    std::string error;
+    if (! read_manifest(manifest, entries, error)) {
+        std::cerr << "pathsim: " << error << std::endl;
+        return -1;
+    }
+    std::vector<BatchJob> jobs;
+    jobs.reserve(entries.size());
+    for (const BatchEntry &entry : entries) {
+        BatchJob job { entry.input_file, entry.output_file, params };
+        if (! entry.profile.empty()) {
+            const PathSimParams *condition = find_condition(entry.profile);
+            if (condition == nullptr) {
+                std::cerr << "pathsim: " << manifest << ":" << entry.line << ": unknown propagation condition " << entry.profile << std::endl;
+                return -1;
+            }
+            job.params = *condition;
+            if (! apply_options(result, job.params)) {
+                std::cerr << "pathsim: " << manifest << ":" << entry.line << ": the options do not apply to propagation condition " << entry.profile << std::endl;
+                return -1;
+            }
+        }
+        if (entry.has_seed)
+            job.params.seed = entry.seed;
+        job.params.threads = 0;
+        jobs.emplace_back(std::move(job));
+    }
+    int threads = result.count("threads") ? params.threads : int(std::thread::hardware_concurrency());
+    return run_batch(jobs, std::max(1, threads), result.count("float") > 0, format, std::cout) == 0 ? 0 : 1;
+}
+
 int main(int argc, char **argv)
 {
 	try {
@@ -40,31 +429,59 @@ from a Windows GUI application by Moe Wheatley, AE4JY, 2000\n\
 	        ("snr", "Signal to Noise Ratio (SNR)", cxxopts::value<double>())
 	        ("spread", "Frequency spread of the 1st path [Hz]", cxxopts::value<double>())
 	        ("offset", "Frequency offset of the 1st path [Hz]", cxxopts::value<double>())
-	        ("delay2", "Delay of the 2nd path [Hz]", cxxopts::value<double>())
+	        ("delay2", "Delay of the 2nd path [ms], fractions of a sample are interpolated", cxxopts::value<double>())
 	        ("spread2", "Frequency spread of the 2nd path [Hz]", cxxopts::value<double>())
 	        ("offset2", "Frequency offset of the 2nd path [Hz]", cxxopts::value<double>())
-	        ("delay3", "Delay of the 2nd path [Hz]", cxxopts::value<double>())
+	        ("delay-rate2", "Drift of the delay of the 2nd path [ms/s]", cxxopts::value<double>())
+	        ("delay3", "Delay of the 3rd path [ms], fractions of a sample are interpolated", cxxopts::value<double>())
 	        ("spread3", "Frequency spread of the 3rd path [Hz]", cxxopts::value<double>())
-	        ("offset3", "Frequency offset of the 3rd path [Hz]", cxxopts::value<double>());
+	        ("offset3", "Frequency offset of the 3rd path [Hz]", cxxopts::value<double>())
+	        ("delay-rate3", "Drift of the delay of the 3rd path [ms/s]", cxxopts::value<double>())
+	        ("filter-taps", "Length of the input 3KHz band pass filter, long filters are applied by FFT", cxxopts::value<int>())
+	        ("seed", "Seed of the fading and noise random generators", cxxopts::value<uint64_t>())
+	        ("snr-sweep", "Write an output per SNR [dB]: \"0,3,6\" or \"from:to:step\", named output_snr<SNR>.wav, same fading and noise realization for all", cxxopts::value<std::string>());
+
+	    options.add_options("Processing")
+	        ("float", "Process in single precision, faster with a noise floor well below 16 bits")
+	        ("block-size", "Samples processed at a time, 1 to 2048 (default), small blocks for low latency streaming", cxxopts::value<int>())
+	        ("threads", "Threads evaluating the paths and the noise concurrently, for multipath profiles, same output", cxxopts::value<int>())
+	        ("resample", "Simulate at 8 kHz: the input is resampled to 8 kHz and the output back to the input rate, faster at 44.1 / 48 kHz")
+	        ("pipeline", "Run the band pass and delay, the paths and the noise on their own threads, same output")
+	        ("monte-carlo", "Simulate N realizations of the condition, the i-th one with --seed + i, into output_seed<seed>.wav each, on --threads threads", cxxopts::value<int>())
+	        ("profiles", "Simulate the comma separated propagation conditions, \"all\" for all of them, on --threads threads, into output_<condition>.wav each", cxxopts::value<std::string>())
+	        ("batch", "Process the jobs listed in a manifest file, a line \"input output [condition [seed]]\" each, on --threads threads", cxxopts::value<std::string>())
+	        ("raw-input", "Input file is raw 16 bit little endian mono PCM at this sample rate [Hz], the output is a WAV file", cxxopts::value<int>())
+	        ("output-format", "Samples of the output: pcm16, pcm24 or float32, the format of the input by default", cxxopts::value<std::string>())
+	        ("raw-output", "Write the samples without the WAV header")
+	        ("dither", "TPDF dither of 16 and 24 bit output, rounded instead of truncated")
+	        ("benchmark", "Measure throughput of the double and float processing of the input file, no output is written");
 
         options.parse_positional({"input_file", "output_file", "positional"});
 
 	    auto result = options.parse(argc, argv);
 
         if (result.count("help")) {
-			std::cout << options.help({"", "Propagation condition", "Propagation"}) << std::endl;
+			std::cout << options.help({"", "Propagation condition", "Propagation", "Processing"}) << std::endl;
 			exit(0);
 		}
 
-        if (argc > 1 || 
-            ((result.count("input_file") != 1 || result.count("output_file") != 1) &&
-             result.arguments().size() != 2))  {
+        bool run_benchmark = result.count("benchmark") > 0;
+        bool run_batch     = result.count("batch") > 0;
+        if (run_batch ? (argc > 1 || result.count("input_file") > 0 || result.count("output_file") > 0) : run_benchmark ?
+                (argc > 1 || (result.count("input_file") != 1 && result.arguments().size() != 1)) :
+                (argc > 1 || 
+                 ((result.count("input_file") != 1 || result.count("output_file") != 1) &&
+                  result.arguments().size() != 2)))  {
             std::cerr << "pathsim: input / output not specified" << std::endl;
             exit(-1);
         }
 
-        std::string input_file  = result.count("input_file")  > 0 ? result["input_file"] .as<std::string>() : result.arguments().front().value();
-        std::string output_file = result.count("output_file") > 0 ? result["output_file"].as<std::string>() : result.arguments()[1].value();
+        std::string input_file;
+        std::string output_file;
+        if (! run_batch)
+            input_file = result.count("input_file") > 0 ? result["input_file"] .as<std::string>() : result.arguments().front().value();
+        if (! run_benchmark && ! run_batch)
+            output_file = result.count("output_file") > 0 ? result["output_file"].as<std::string>() : result.arguments()[1].value();
 
         PathSimParams params;
         // Parse the propagation condition parameter sets.
@@ -79,52 +496,90 @@ from a Windows GUI application by Moe Wheatley, AE4JY, 2000\n\
                 }
             }
 
-        if (result.count("snr"))
-            params.noise = { true, result["snr"].as<double>() };
-
-        for (int i = 0; i < 3; ++ i) {
-            auto init_path = [i, &params](){
-                if (int(params.paths.size()) <= i)
-                    params.paths.push_back({});
-            };
-            std::string sidx;
-            if (i > 0)
-                sidx = std::to_string(i);
-            std::string delay = std::string("delay") + sidx;
-            if (result.count(delay)) {
-                init_path();
-                params.paths.back().delay = result[delay].as<double>();
+        if (! apply_options(result, params))
+            return -1;
+
+        OutputFormat format;
+        if (result.count("output-format")) {
+            const std::string name = result["output-format"].as<std::string>();
+            format.same_as_input = false;
+            if (name == "pcm16")
+                format.sample_format = SampleFormat::PCM16;
+            else if (name == "pcm24")
+                format.sample_format = SampleFormat::PCM24;
+            else if (name == "float32")
+                format.sample_format = SampleFormat::FLOAT32;
+            else {
+                std::cerr << "pathsim: unknown output format " << name << ", expected pcm16, pcm24 or float32" << std::endl;
+                return -1;
+            }
+        }
+        format.raw    = result.count("raw-output") > 0;
+        format.dither = result.count("dither") > 0;
+        // The dither of the batch jobs and of the realizations follows their seeds.
+        format.dither_seed = params.seed;
+
+        if (result.count("raw-input") && (run_batch || run_benchmark || result.count("snr-sweep") || result.count("profiles") || result.count("monte-carlo"))) {
+            std::cerr << "pathsim: --raw-input cannot be combined with --batch, --benchmark, --snr-sweep, --profiles or --monte-carlo" << std::endl;
+            return -1;
+        }
+        if (result.count("raw-input") && ! check_sample_rate(result["raw-input"].as<int>()))
+            return -1;
+        if (run_batch)
+            return batch(result, params, format, result["batch"].as<std::string>());
+        if (run_benchmark)
+            return benchmark(params, input_file);
+        if (result.count("profiles") || result.count("monte-carlo")) {
+            if (result.count("snr-sweep") || result.count("resample") || result.count("pipeline")) {
+                std::cerr << "pathsim: --profiles and --monte-carlo cannot be combined with --snr-sweep, --resample or --pipeline" << std::endl;
+                return -1;
             }
-            std::string spread = std::string("spread") + sidx;
-            if (result.count(spread)) {
-                init_path();
-                params.paths.back().spread = result[spread].as<double>();
+            if (result.count("profiles") && ! params.cmdline_param.empty()) {
+                std::cerr << "pathsim: --profiles cannot be combined with a propagation condition" << std::endl;
+                return -1;
             }
-            std::string offset = std::string("offset") + sidx;
-            if (result.count(offset)) {
-                init_path();
-                params.paths.back().offset = result[offset].as<double>();
+            int realizations = result.count("monte-carlo") ? result["monte-carlo"].as<int>() : 0;
+            if (result.count("monte-carlo") && realizations < 1) {
+                std::cerr << "pathsim: number of the Monte Carlo realizations has to be at least 1" << std::endl;
+                return -1;
             }
+            return profiles(result, params, result.count("profiles") ? result["profiles"].as<std::string>() : std::string(),
+                realizations, format, input_file, output_file);
         }
-
-        AudioFile<double> audio_file;
-        bool loaded  = audio_file.load(input_file);
-        if (! loaded) {
-            std::cout << "failed loading input file: " << input_file << std::endl;
-            exit(1);
+        if (result.count("snr-sweep")) {
+            std::vector<double> snrs;
+            if (! parse_snr_sweep(result["snr-sweep"].as<std::string>(), snrs)) {
+                std::cerr << "pathsim: invalid SNR sweep " << result["snr-sweep"].as<std::string>() << std::endl;
+                return -1;
+            }
+            if (result.count("resample") || result.count("pipeline")) {
+                std::cerr << "pathsim: --snr-sweep cannot be combined with --resample or --pipeline" << std::endl;
+                return -1;
+            }
+            return result.count("float") ?
+                simulate_snr_sweep<float> (params, snrs, format, input_file, output_file) :
+                simulate_snr_sweep<double>(params, snrs, format, input_file, output_file);
         }
-        int  len     = audio_file.getNumSamplesPerChannel();
-        int  nblocks = (len + PathSimProcessor::BUF_SIZE - 1) / PathSimProcessor::BUF_SIZE;
-
-        PathSimProcessor processor;
-        processor.init(params);
-        audio_file.samples.front().resize(PathSimProcessor::BUF_SIZE * nblocks, 0.);
-        for (int i = 0; i < nblocks; ++ i)
-            processor.process_buffer(audio_file.samples.front().data() + i * PathSimProcessor::BUF_SIZE);
-        audio_file.samples.front().resize(len);
-        for (int k = 1; k < audio_file.getNumChannels(); ++ k)
-            audio_file.samples[k] = audio_file.samples.front();
-        audio_file.save(result["output_file"].as<std::string>(), AudioFileFormat::Wave);
+        ProcessingMode mode = PROCESS_BLOCKS;
+        if (result.count("resample") > 0)
+            mode = PROCESS_RESAMPLED;
+        if (result.count("pipeline") > 0) {
+            if (mode != PROCESS_BLOCKS || params.threads > 1) {
+                std::cerr << "pathsim: --pipeline cannot be combined with --resample or --threads" << std::endl;
+                return -1;
+            }
+            mode = PROCESS_PIPELINED;
+        }
+        // WAV and raw files are streamed, the other formats are loaded whole.
+        uint32_t raw_rate = result.count("raw-input") ? uint32_t(std::max(0, result["raw-input"].as<int>())) : 0;
+        int status = result.count("float") ?
+            simulate_streaming<float> (params, mode, raw_rate, format, input_file, output_file) :
+            simulate_streaming<double>(params, mode, raw_rate, format, input_file, output_file);
+        if (status >= 0)
+            return status;
+        return result.count("float") ?
+            simulate<float> (params, mode, format, input_file, output_file) :
+            simulate<double>(params, mode, format, input_file, output_file);
 	}
 	catch (const cxxopts::OptionException& e)
 	{
@@ -0,0 +1,28 @@
+// Input file of the command line tests: a few seconds of two tones at 8 kHz, 16 bit mono.
+
+#include "WavStream.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace PathSim;
+
+static constexpr uint32_t SAMPLE_RATE = 8000;
+static constexpr int 	  SECONDS 	  = 3;
+
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s output.wav\n", argv[0]);
+		return 1;
+	}
+	std::vector<double> samples(SAMPLE_RATE * SECONDS);
+	for (size_t i = 0; i < samples.size(); ++ i)
+		samples[i] = 0.3 * sin(2. * M_PI * 700. / SAMPLE_RATE * double(i)) + 0.3 * sin(2. * M_PI * 1900. / SAMPLE_RATE * double(i));
+	if (! write_wav_file(argv[1], samples.data(), samples.size(), SAMPLE_RATE, 1, SampleFormat::PCM16, OutputFormat())) {
+		fprintf(stderr, "failed writing %s\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+// Phase and amplitude drift of the recursive NCO over a multi-hour run, against a long double reference.
+//
+// Two NCOs of the same frequency mix a constant signal into the cosine and the sine of their phase:
+// Re{1 * 1 * exp(j phase)} and Re{1 * -j * exp(j phase)}. The phase and the amplitude of every sample
+// are compared with the exact phase of the sample, reduced in long double once per block.
+
+#include "NCO.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+using namespace PathSim;
+
+static constexpr double SAMPLE_RATE 	= 8000.;
+static constexpr int 	BLOCK_SIZE 		= 1024;
+// Three hours of samples, in whole blocks.
+static constexpr long 	NUM_BLOCKS 		= long(3 * 3600 * SAMPLE_RATE) / BLOCK_SIZE;
+static constexpr double MAX_PHASE_ERROR = 1e-8;
+static constexpr double MAX_AMPL_ERROR 	= 1e-12;
+
+static bool run(double offset)
+{
+	const double phase_inc = 2. * M_PI / SAMPLE_RATE * offset;
+	NCO<double> nco_cos, nco_sin;
+	nco_cos.init(phase_inc);
+	nco_sin.init(phase_inc);
+
+	std::vector<double> one(BLOCK_SIZE, 1.), zero(BLOCK_SIZE, 0.), minus_one(BLOCK_SIZE, -1.);
+	std::vector<double> c(BLOCK_SIZE), s(BLOCK_SIZE);
+	const cmplx_block<const double> a 		{ one.data(), zero.data() };
+	const cmplx_block<const double> b_cos 	{ one.data(), zero.data() };
+	const cmplx_block<const double> b_sin 	{ zero.data(), minus_one.data() };
+
+	const long double pi2 = 2.L * 3.14159265358979323846264338327950288L;
+	double max_phase = 0., max_ampl = 0.;
+	for (long blk = 0; blk < NUM_BLOCKS; ++ blk) {
+		std::fill(c.begin(), c.end(), 0.);
+		std::fill(s.begin(), s.end(), 0.);
+		nco_cos.add_mixed_real(a, b_cos, c.data(), BLOCK_SIZE);
+		nco_sin.add_mixed_real(a, b_sin, s.data(), BLOCK_SIZE);
+		const long double base = fmodl((long double)(blk * BLOCK_SIZE) * (long double)phase_inc, pi2);
+		for (int i = 0; i < BLOCK_SIZE; ++ i) {
+			long double err = (long double)atan2(s[i], c[i]) - (base + (long double)i * (long double)phase_inc);
+			err = remainderl(err, pi2);
+			max_phase = std::max(max_phase, fabs(double(err)));
+			max_ampl  = std::max(max_ampl, fabs(sqrt(c[i] * c[i] + s[i] * s[i]) - 1.));
+		}
+	}
+	const bool ok = max_phase <= MAX_PHASE_ERROR && max_ampl <= MAX_AMPL_ERROR;
+	printf("offset %8.2f Hz: max phase error %.3g rad, max amplitude error %.3g%s\n", offset, max_phase, max_ampl, ok ? "" : "  FAILED");
+	return ok;
+}
+
+int main()
+{
+	bool ok = true;
+	for (double offset : { 0.5, 1., 10., 117.3, 1235. })
+		ok = run(offset) && ok;
+	return ok ? 0 : 1;
+}